@@ -0,0 +1,373 @@
+// Headless benchmark for the solver. Sweeps grid sizes, backends, thread
+// counts, time-tiling depths, precisions and step counts, and reports
+// cells updated per second and the effective memory bandwidth.
+//
+//   emsim_bench [--sizes 301,1001,3001,8001] [--backends cpu,metal]
+//               [--threads 1,4] [--tiles 1,8] [--precisions f32,f16]
+//               [--steps 100] [--repeats 3] [--dimensions 2,3]
+//               [--format json|csv|markdown] [--output FILE]
+//
+// Every configuration is timed --repeats times after a short warm-up and
+// the median is reported. The markdown format produces the performance
+// table in the README. With --dimensions 3 the sizes are the edge of a
+// cubic grid for Simulation3D, which only runs on the CPU; they default
+// to 64,128,256, and grids that would not fit in physical memory are
+// skipped. Its tile column is 1 with the slab decomposition and 0
+// without it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Simulation.hpp"
+#include "Simulation3D.hpp"
+#include "CpuBackend.hpp"
+
+#ifdef EMSIM_HAS_METAL
+#include "MetalBackend.hpp"
+#endif
+
+struct BenchConfig {
+    std::vector<int> sizes{301, 1001, 3001, 8001};
+    std::vector<int> sizes3D{64, 128, 256};
+    std::vector<std::string> backends{"cpu"};
+    std::vector<int> threads{0};
+    std::vector<int> tiles{1, 8};
+    std::vector<std::string> precisions{"f32"};
+    std::vector<int> steps{100};
+    std::vector<int> dimensions{2};
+    int repeats{3};
+    std::string format{"json"};
+    std::string output;
+};
+
+struct BenchResult {
+    std::string backend;
+    std::string precision;
+    std::string isa;
+    int dimensions;
+    int size;
+    int threads;
+    int tile;
+    int steps;
+    double seconds;
+    double cellsPerSecond;
+    double bytesPerSecond;
+};
+
+static std::vector<std::string> splitList(const std::string &list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::vector<int> splitInts(const std::string &list) {
+    std::vector<int> values;
+    for (const std::string &item: splitList(list)) {
+        values.push_back(std::atoi(item.c_str()));
+    }
+    return values;
+}
+
+static bool parseArguments(int argc, char **argv, BenchConfig &config) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (option == "--sizes") {
+            config.sizes = splitInts(value);
+            config.sizes3D = config.sizes;
+        } else if (option == "--backends") {
+            config.backends = splitList(value);
+        } else if (option == "--threads") {
+            config.threads = splitInts(value);
+        } else if (option == "--tiles") {
+            config.tiles = splitInts(value);
+        } else if (option == "--precisions") {
+            config.precisions = splitList(value);
+        } else if (option == "--steps") {
+            config.steps = splitInts(value);
+        } else if (option == "--dimensions") {
+            config.dimensions = splitInts(value);
+        } else if (option == "--repeats") {
+            config.repeats = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--format") {
+            config.format = value;
+        } else if (option == "--output") {
+            config.output = value;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bytes a step has to move if nothing stays in cache between half-steps:
+// E_z, H_x and H_y read and written, the material byte and the
+// conductor bit read. Time tiling moves less, so its figure is an
+// effective bandwidth.
+template <typename S>
+static double bytesPerCell() {
+    return 6.0 * sizeof(S) + 1.125;
+}
+
+// The same for the six components and the material byte of a 3D cell.
+template <typename S>
+static double bytesPerCell3D() {
+    return 12.0 * sizeof(S) + 1.0;
+}
+
+// Times one configuration; returns false if it cannot run here.
+template <typename S, typename C>
+static bool runOne(const std::string &backend, const char *precision, int size, int threads, int tile,
+    int steps, int repeats, BenchResult &result) {
+    using Sim = BasicSimulation<S, C>;
+    Sim sim(size, size, C(0.1f), C(0.1f), C(0.05f));
+
+    std::string isa = "-";
+    if (backend == "cpu") {
+        sim.template useBackend<BasicCpuBackend<S, C>>(threads);
+        auto &cpu = static_cast<BasicCpuBackend<S, C>&>(sim.backend());
+        cpu.setTiling(tile);
+        // Measure full sweeps; a fresh grid would otherwise be mostly
+        // skipped as quiescent.
+        cpu.setActivityTracking(false);
+        threads = cpu.threadCount();
+        isa = cpu.isa();
+    } else if (backend == "metal") {
+#ifdef EMSIM_HAS_METAL
+        // The Metal kernels are single precision only.
+        if constexpr (std::is_same_v<S, float> && std::is_same_v<C, float>) {
+            sim.template useBackend<MetalBackend>();
+            threads = 0;
+            tile = 1;
+        } else {
+            return false;
+        }
+#else
+        return false;
+#endif
+    } else {
+        return false;
+    }
+
+    // Warm-up: first touch of the fields, kernel compilation, pool start.
+    sim.advance(2);
+    sim.synchronize();
+
+    std::vector<double> seconds;
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        auto start = std::chrono::steady_clock::now();
+        sim.advance(steps);
+        sim.synchronize();
+        auto stop = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(stop - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    const double median = seconds[seconds.size() / 2];
+    const double cells = static_cast<double>(size) * size * steps;
+
+    result = {backend, precision, isa, 2, size, threads, tile, steps, median,
+        cells / median, cells * bytesPerCell<S>() / median};
+    return true;
+}
+
+// 3D counterpart of runOne(); tile selects the slab decomposition.
+template <typename S, typename C>
+static bool runOne3D(const std::string &backend, const char *precision, int size, int threads, int tile,
+    int steps, int repeats, BenchResult &result) {
+    if (backend != "cpu") {
+        return false;
+    }
+    const double edge = size + 2.0;
+    const double footprint = edge * edge * edge * (6.0 * sizeof(S) + 1.0);
+    const double memory = static_cast<double>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+    if (memory > 0 && footprint > memory) {
+        std::cerr << size << "x" << size << "x" << size << " needs " << footprint / 1e9
+            << " GB, more than physical memory" << std::endl;
+        return false;
+    }
+    BasicSimulation3D<S, C> sim(size, size, size, C(0.1f), C(0.05f), threads);
+    sim.setSlabDecomposition(tile > 0);
+    sim.advance(2);
+
+    std::vector<double> seconds;
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        auto start = std::chrono::steady_clock::now();
+        sim.advance(steps);
+        auto stop = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(stop - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    const double median = seconds[seconds.size() / 2];
+    const double cells = static_cast<double>(size) * size * size * steps;
+
+    result = {backend, precision, sim.isa(), 3, size, sim.threadCount(), tile > 0 ? 1 : 0, steps, median,
+        cells / median, cells * bytesPerCell3D<S>() / median};
+    return true;
+}
+
+template <typename S, typename C>
+static bool runDimensions(int dimensions, const std::string &backend, const char *precision, int size, int threads,
+    int tile, int steps, int repeats, BenchResult &result) {
+    if (dimensions == 3) {
+        return runOne3D<S, C>(backend, precision, size, threads, tile, steps, repeats, result);
+    }
+    return runOne<S, C>(backend, precision, size, threads, tile, steps, repeats, result);
+}
+
+static bool runPrecision(const std::string &precision, int dimensions, const std::string &backend, int size,
+    int threads, int tile, int steps, int repeats, BenchResult &result) {
+    if (precision == "f32") {
+        return runDimensions<float, float>(dimensions, backend, "f32", size, threads, tile, steps, repeats, result);
+    } else if (precision == "f64") {
+        return runDimensions<double, double>(dimensions, backend, "f64", size, threads, tile, steps, repeats, result);
+    } else if (precision == "f16") {
+        return runDimensions<Half, float>(dimensions, backend, "f16", size, threads, tile, steps, repeats, result);
+    } else if (precision == "bf16") {
+        return runDimensions<BFloat16, float>(dimensions, backend, "bf16", size, threads, tile, steps, repeats,
+            result);
+    }
+    return false;
+}
+
+static std::string timestamp() {
+    char buffer[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+static std::string compilerName() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+static void writeJson(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "{\n";
+    out << "  \"version\": \"" << EMSIM_VERSION << "\",\n";
+    out << "  \"timestamp\": \"" << timestamp() << "\",\n";
+    out << "  \"compiler\": \"" << compilerName() << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        out << "    {\"backend\": \"" << r.backend << "\", \"precision\": \"" << r.precision
+            << "\", \"isa\": \"" << r.isa << "\", \"dimensions\": " << r.dimensions << ", \"size\": " << r.size
+            << ", \"threads\": " << r.threads << ", \"tile\": " << r.tile << ", \"steps\": " << r.steps << ", \"seconds\": " << r.seconds
+            << ", \"cells_per_second\": " << r.cellsPerSecond << ", \"bytes_per_second\": " << r.bytesPerSecond
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void writeCsv(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "backend,precision,isa,dimensions,size,threads,tile,steps,seconds,cells_per_second,bytes_per_second\n";
+    for (const BenchResult &r: results) {
+        out << r.backend << "," << r.precision << "," << r.isa << "," << r.dimensions << "," << r.size << ","
+            << r.threads << "," << r.tile << "," << r.steps << "," << r.seconds << "," << r.cellsPerSecond << ","
+            << r.bytesPerSecond << "\n";
+    }
+}
+
+static std::string gridName(const BenchResult &r) {
+    std::string edge = std::to_string(r.size);
+    return r.dimensions == 3 ? edge + "x" + edge + "x" + edge : edge + "x" + edge;
+}
+
+static void writeMarkdown(std::ostream &out, const std::vector<BenchResult> &results) {
+    out << "| Grid | Backend | Precision | ISA | Threads | Tile | Mcells/s | GB/s |\n";
+    out << "| ---- | ------- | --------- | --- | ------- | ---- | -------- | ---- |\n";
+    char line[256];
+    for (const BenchResult &r: results) {
+        std::snprintf(line, sizeof(line), "| %s | %s | %s | %s | %d | %d | %.1f | %.1f |\n",
+            gridName(r).c_str(), r.backend.c_str(), r.precision.c_str(), r.isa.c_str(), r.threads, r.tile,
+            r.cellsPerSecond / 1e6, r.bytesPerSecond / 1e9);
+        out << line;
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    if (!parseArguments(argc, argv, config)) {
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (int dimensions: config.dimensions) {
+        for (const std::string &precision: config.precisions) {
+            for (const std::string &backend: config.backends) {
+                for (int size: dimensions == 3 ? config.sizes3D : config.sizes) {
+                    for (int threads: config.threads) {
+                        for (std::size_t t = 0; t < config.tiles.size(); t++) {
+                            const int tile = config.tiles[t];
+                            // 3D only tells slabs (> 0) from none.
+                            if (dimensions == 3 && std::any_of(config.tiles.begin(), config.tiles.begin() + t,
+                                    [&](int earlier) { return (earlier > 0) == (tile > 0); })) {
+                                continue;
+                            }
+                            for (int steps: config.steps) {
+                                BenchResult result;
+                                if (!runPrecision(precision, dimensions, backend, size, threads, tile, steps,
+                                        config.repeats, result)) {
+                                    std::cerr << "Skipping " << backend << "/" << precision << std::endl;
+                                    continue;
+                                }
+                                std::cerr << gridName(result) << " " << backend << " " << precision
+                                    << " threads=" << result.threads << " tile=" << result.tile << " steps=" << steps
+                                    << ": " << result.cellsPerSecond / 1e6 << " Mcells/s" << std::endl;
+                                results.push_back(result);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!config.output.empty()) {
+        file.open(config.output);
+        if (!file) {
+            std::cerr << "Cannot write " << config.output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = config.output.empty() ? std::cout : file;
+
+    if (config.format == "csv") {
+        writeCsv(out, results);
+    } else if (config.format == "markdown") {
+        writeMarkdown(out, results);
+    } else {
+        writeJson(out, results);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef ACTIVITY_MAP_HPP
+#define ACTIVITY_MAP_HPP
+
+// Which tiles of the grid are worth updating. The grid is cut into
+// kTileSize x kTileSize tiles; a tile is active if it holds a nonzero
+// field, drives a source, or borders such a tile. A field spreads at most
+// one cell per step, so a tile outside this set stays exactly zero for
+// kTileSize / 2 steps and its update can be skipped without changing the
+// result. The CPU backend rebuilds the map that often.
+
+#include <cstdint>
+#include <vector>
+
+class ActivityMap {
+public:
+    static constexpr int kTileSize = 32;
+
+    // Columns [begin, end) of consecutive active tiles in one tile row.
+    struct Run {
+        int begin, end;
+    };
+
+    ActivityMap(int rows, int cols);
+
+    int tileRows() const { return tileRows_; }
+    int tileCols() const { return tileCols_; }
+
+    bool active(int ti, int tj) const { return tiles[ti * tileCols_ + tj] != 0; }
+    // Marking tiles of different tile rows from different threads is safe.
+    void mark(int ti, int tj) { tiles[ti * tileCols_ + tj] = 1; }
+    // Marks the tiles covering cells [i0, i1) x [j0, j1), clipped.
+    void markCells(int i0, int j0, int i1, int j1);
+
+    void clear();
+    void fill();
+
+    // Adds every tile next to (or diagonal to) a marked one and rebuilds
+    // the runs.
+    void dilate();
+
+    // Active runs of the tile row holding cell row i.
+    const std::vector<Run> &runs(int i) const { return rowRuns[i / kTileSize]; }
+
+    // Share of active tiles, in [0, 1].
+    double fraction() const;
+    bool full() const { return activeTiles == static_cast<int>(tiles.size()); }
+
+private:
+    void rebuildRuns();
+
+    int rows_, cols_;
+    int tileRows_, tileCols_;
+    int activeTiles{0};
+    std::vector<std::uint8_t> tiles;
+    std::vector<std::uint8_t> scratch;
+    std::vector<std::vector<Run>> rowRuns;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+// Interface for the engines that advance a Simulation's fields.
+// A backend is created for one Simulation and either works on its
+// host vectors directly (CPU) or keeps its own copy of them (GPU).
+
+#include <cstdint>
+
+#include "ConductorMask.hpp"
+#include "Linear2DVector.hpp"
+#include "Precision.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+template <typename Storage, typename Compute>
+class BasicBackend {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    explicit BasicBackend(Simulation &sim) : sim(sim) {}
+
+    virtual ~BasicBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    virtual void stepElectricField() = 0;
+    virtual void stepMagneticField() = 0;
+
+    // Runs whole time steps (E update, source, H update), advancing
+    // Simulation::time. The default calls the half-steps one at a time.
+    virtual void advance(int steps);
+
+    // Storage the backend advances. Writes through these pointers are
+    // seen by the next step.
+    virtual Storage *electricField() = 0;
+    virtual std::uint8_t *materialField() = 0;
+
+    // Called after Simulation::materials grew or changed.
+    virtual void materialsChanged() {}
+
+    // Called after the cells in rect of Simulation::conductors changed.
+    virtual void conductorsChanged(const MaskRect &rect) { (void) rect; }
+
+    // Called after the fields were written other than by the backend or
+    // the Ricker source.
+    virtual void fieldsChanged() {}
+
+    // Copies backend-side state back into the Simulation's host vectors.
+    virtual void synchronize() {}
+
+protected:
+    Simulation &sim;
+};
+
+using Backend = BasicBackend<float, float>;
+
+#endif
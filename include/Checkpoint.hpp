@@ -0,0 +1,91 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+// Versioned binary snapshot of a Simulation, for restarting preempted
+// runs. A file holds a header page and one section per array: E_z, H_x,
+// H_y, the material ids and table, the conductor mask and, if present,
+// the CPML psi fields, the running sums of the DFT monitors, the plane
+// wave's auxiliary grid and the polarization of dispersive cells. Every
+// section starts on a kMappableAlignment boundary and holds the array's
+// whole padded storage, so on restore the field sections are mapped
+// copy-on-write straight over the Simulation's own storage instead of
+// being read: pages are only loaded when the solver first touches them.
+//
+// Files are written under a temporary name and renamed into place, so a
+// crash never leaves a half-written checkpoint behind and a mapping of
+// the previous one stays valid while the next is written. Values are
+// stored in host byte order; the header records the precision and grid
+// layout, and a checkpoint only loads into a Simulation that matches.
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Simulation.hpp"
+
+// Version 2 adds the DFT monitor sums, the plane wave's auxiliary grid
+// and the dispersive polarization; version 1 files still load.
+constexpr std::uint32_t kCheckpointVersion = 2;
+
+struct CheckpointInfo {
+    std::uint32_t version;
+    std::string precision;  // "f32", "f64", "f16" or "bf16"
+    int M, N;
+    long step;
+    double time;
+    int cpmlThickness;  // 0 if the run had PEC edges
+};
+
+// Reads just the header, e.g. to pick the precision before building the
+// Simulation to restore into.
+bool readCheckpointInfo(const std::string &path, CheckpointInfo &info, std::string &error);
+
+// Writes sim's state along with the caller's step count. sim is
+// synchronized first.
+template <typename Storage, typename Compute>
+bool saveCheckpoint(BasicSimulation<Storage, Compute> &sim, const std::string &path, long step,
+    std::string &error);
+
+// Replaces sim's fields, materials, conductors, source position, time and
+// absorbing boundary with those in path and returns the saved step count.
+// sim must have the grid, spacing and precision the checkpoint was taken
+// with. DFT monitors registered in the same order and shape as at the
+// save continue their sums, any further ones start from zero, and a plane
+// wave set up as at the save continues its auxiliary grid.
+template <typename Storage, typename Compute>
+bool loadCheckpoint(BasicSimulation<Storage, Compute> &sim, const std::string &path, long &step,
+    std::string &error);
+
+// Saves in the background. save() copies the state, which is all the
+// solver has to wait for, and returns while a worker writes the file.
+// Only one write is in flight; a second save() first waits for it.
+template <typename Storage, typename Compute>
+class BasicCheckpointWriter {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    BasicCheckpointWriter() = default;
+    ~BasicCheckpointWriter();
+
+    BasicCheckpointWriter(const BasicCheckpointWriter&) = delete;
+    BasicCheckpointWriter& operator=(const BasicCheckpointWriter&) = delete;
+
+    void save(Simulation &sim, const std::string &path, long step);
+
+    // Waits for the write in flight. Returns false, with error set, if it
+    // or any earlier one failed.
+    bool wait(std::string &error);
+
+private:
+    struct Image;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::string firstError;
+};
+
+using CheckpointWriter = BasicCheckpointWriter<float, float>;
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef COLORMAP_HPP
+#define COLORMAP_HPP
+
+// Colormaps as quantized lookup tables and the conversion of a field
+// into packed RGBA pixels. Pixels are 32-bit words holding the bytes
+// r, g, b, a in memory order, which is the layout sf::Texture::update()
+// and most image formats expect. Nothing here depends on a window, so the
+// same code serves the display and headless image export.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Kernels.hpp"
+
+constexpr std::uint32_t packRgba(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) {
+    return static_cast<std::uint32_t>(r) | static_cast<std::uint32_t>(g) << 8 |
+        static_cast<std::uint32_t>(b) << 16 | static_cast<std::uint32_t>(a) << 24;
+}
+
+class Colormap {
+public:
+    static constexpr int kEntries = 4096;
+
+    // Built-in maps: redblue (the original display), grayscale, coolwarm
+    // and viridis. Returns nullptr for unknown names.
+    static const Colormap *find(const std::string &name);
+    static const std::vector<const Colormap*> &all();
+
+    const std::string &name() const { return name_; }
+
+    // kEntries colours for values spread evenly over [0, 1].
+    const std::uint32_t *table() const { return table_.data(); }
+
+private:
+    Colormap(const std::string &name, std::vector<std::uint32_t> table)
+        : name_(name), table_(std::move(table)) {}
+
+    std::string name_;
+    std::vector<std::uint32_t> table_;
+};
+
+// Values mapped onto the ends of the colormap.
+struct ColorRange {
+    float low{-0.3f}, high{0.3f};
+};
+
+// How a FieldColorizer picks its range for each frame.
+enum class RangeMode {
+    Fixed,      // the range given to setRange()
+    Symmetric,  // [-max |value|, max |value|] of the frame
+    Auto,       // [min value, max value] of the frame
+};
+
+// Rows [rowBegin, rowEnd) of field, element (i, j) at field[i * pitch + j].
+ColorRange fieldRange(const float *field, int pitch, int rowBegin, int rowEnd, int cols, bool symmetric);
+
+class FieldColorizer {
+public:
+    explicit FieldColorizer(const Colormap &colormap = *Colormap::all().front());
+
+    void setColormap(const Colormap &colormap) { map = &colormap; }
+    const Colormap &colormap() const { return *map; }
+
+    void setRangeMode(RangeMode mode) { rangeMode = mode; }
+    RangeMode mode() const { return rangeMode; }
+
+    void setRange(ColorRange range) { fixedRange = range; }
+    const ColorRange &range() const { return fixedRange; }
+
+    void setConductorColor(std::uint32_t color) { conductorColor = color; }
+
+    // Range to use for a frame under the current mode; scans the field
+    // unless the mode is Fixed.
+    ColorRange frameRange(const float *field, int pitch, int rows, int cols) const;
+
+    // Converts rows [rowBegin, rowEnd) of field into out, pixel (i, j) at
+    // out[i * outPitch + j]. conductor may be nullptr. Rows are
+    // independent, so the range may be split between threads.
+    void colorizeRows(const float *field, int pitch, const ConductorMask *conductor,
+        std::uint32_t *out, int outPitch, int rowBegin, int rowEnd, int cols, ColorRange range) const;
+
+private:
+    const Colormap *map;
+    RangeMode rangeMode{RangeMode::Fixed};
+    ColorRange fixedRange;
+    std::uint32_t conductorColor{packRgba(255, 0, 255)};
+    const ColorizeTable &kernels;
+};
+
+// Writes width x height packed RGBA pixels as a binary PPM.
+bool writeImage(const std::string &path, const std::uint32_t *pixels, int width, int height);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef CONDUCTOR_MASK_HPP
+#define CONDUCTOR_MASK_HPP
+
+// One bit per cell marking perfect conductors. Bit j of a row is bit
+// (j % 64) of word j / 64; every row carries one spare zero word after
+// its last one, so bits(row, j) may read the word following j's. Edits
+// work a word at a time along each row and grow a dirty rectangle that
+// the Simulation uses to refresh whatever it derives from the mask.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Linear2DVector.hpp"
+
+// Cells [i0, i1) x [j0, j1).
+struct MaskRect {
+    int i0{0}, j0{0}, i1{0}, j1{0};
+
+    bool empty() const { return i0 >= i1 || j0 >= j1; }
+    // Smallest rectangle holding both.
+    MaskRect merged(const MaskRect &other) const;
+};
+
+// A point in cell coordinates; cell (i, j) is centred on (i, j).
+struct MaskPoint {
+    double i, j;
+};
+
+class ConductorMask {
+public:
+    using Word = std::uint64_t;
+    static constexpr int kWordBits = 64;
+
+    ConductorMask(int rows, int cols);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    // Words from one row to the next, including the spare one.
+    int pitch() const { return pitch_; }
+
+    Word *row(int i) { return words.data() + static_cast<std::size_t>(i) * pitch_; }
+    const Word *row(int i) const { return words.data() + static_cast<std::size_t>(i) * pitch_; }
+    Word *storage() { return words.data(); }
+    const Word *storage() const { return words.data(); }
+    std::size_t storageSize() const { return words.size(); }
+
+    bool test(int i, int j) const { return test(row(i), j); }
+    static bool test(const Word *row, int j) { return (row[j / kWordBits] >> (j % kWordBits)) & 1; }
+
+    // 64 bits of a row starting at column j; bits past the row are 0.
+    static Word bits(const Word *row, int j) {
+        const int shift = j % kWordBits;
+        const Word *word = row + j / kWordBits;
+        return shift == 0 ? word[0] : (word[0] >> shift) | (word[1] << (kWordBits - shift));
+    }
+
+    // Edits clip to the grid and set cells to value.
+    void set(int i, int j, bool value);
+    void fillRect(const MaskRect &rect, bool value);
+    void clear(const MaskRect &rect) { fillRect(rect, false); }
+    // Cells whose centre lies inside the polygon (even-odd rule).
+    void fillPolygon(const std::vector<MaskPoint> &vertices, bool value);
+    // Cells within radius of the segment from a to b, i.e. the path of a
+    // round brush dragged along it.
+    void stroke(MaskPoint a, MaskPoint b, double radius, bool value);
+    // Copies every cell of other, which must have the same shape.
+    void assign(const ConductorMask &other);
+
+    // Rectangle covering every edit since the last takeDirty().
+    const MaskRect &dirty() const { return dirtyRect; }
+    MaskRect takeDirty();
+
+    // Number of conductor cells.
+    long count() const;
+
+private:
+    // Columns [j0, j1) of row i, already clipped.
+    void fillSpan(int i, int j0, int j1, bool value);
+    void markDirty(const MaskRect &rect);
+
+    int rows_, cols_, pitch_;
+    std::vector<Word, AlignedAllocator<Word>> words;
+    MaskRect dirtyRect;
+};
+
+#endif
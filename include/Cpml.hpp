@@ -0,0 +1,99 @@
+#ifndef CPML_HPP
+#define CPML_HPP
+
+// Convolutional PML (Roden & Gedney, with the complex frequency shift)
+// along the four grid edges. The interior kernels run unchanged over the
+// whole grid; afterwards the cells inside the boundary slabs get a
+// correction that adds the stretched-coordinate terms:
+//
+//   E_z += ezh * ((1/kx - 1) dH_y + psi_ezx - (1/ky - 1) dH_x - psi_ezy)
+//   psi  = b * psi + c * d(field)
+//
+// and likewise for H_x and H_y. The auxiliary psi fields only exist in the
+// slabs, so their memory and cost scale with the perimeter. The outer
+// ring of E_z stays PEC and terminates the layer.
+
+#include <array>
+#include <vector>
+
+#include "Linear2DVector.hpp"
+#include "Precision.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+struct CpmlParameters {
+    // Cells per edge; 0 keeps the plain PEC boundary.
+    int thickness{10};
+    // Polynomial grading of sigma and kappa.
+    double grading{3.0};
+    // Multiple of the usual optimum sigma_max = 0.8 (m + 1) / (eta0 dx).
+    double sigmaScale{1.0};
+    double kappaMax{1.0};
+    // alpha * deltaT / eps0 at the inner edge of the layer, falling to 0
+    // at the outer edge.
+    double alphaMax{0.05};
+};
+
+template <typename Storage, typename Compute>
+class BasicCpml {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    BasicCpml(Simulation &sim, const CpmlParameters &parameters);
+
+    const CpmlParameters &parameters() const { return params; }
+
+    // Adds the boundary terms to rows [rowBegin, rowEnd), right after the
+    // interior update of those rows. Rows are independent, so the range
+    // may be split between threads.
+    void correctElectricRows(int rowBegin, int rowEnd);
+    void correctMagneticRows(int rowBegin, int rowEnd);
+
+    // True if thickness fits an m x n grid.
+    static bool fits(int m, int n, int thickness);
+
+    // The psi fields, which checkpoints save along with the grid.
+    std::array<Linear2DVector<Compute>*, 4> state() { return {&psiEzx, &psiHyx, &psiEzy, &psiHxy}; }
+
+private:
+    // One direction: the cells [0, thickness) and [size-1-thickness, size)
+    // along it, numbered 0 .. 2 * thickness in the psi arrays.
+    struct Axis {
+        int size{0};
+        int thickness{0};
+
+        int slabSize() const { return 2 * thickness + 1; }
+        int highBegin() const { return size - 1 - thickness; }
+        // Slab index of cell i, or -1 if it is in the interior.
+        int index(int i) const {
+            if (i < thickness) {
+                return i;
+            }
+            if (i >= highBegin()) {
+                return thickness + (i - highBegin());
+            }
+            return -1;
+        }
+        int cell(int k) const { return k < thickness ? k : highBegin() + (k - thickness); }
+
+        // b, c and 1/kappa - 1 at the E_z positions and at the H
+        // positions half a cell further on.
+        std::vector<Compute> bE, cE, kE;
+        std::vector<Compute> bH, cH, kH;
+    };
+
+    void buildAxis(Axis &axis, int size, Compute courant);
+
+    Simulation &sim;
+    CpmlParameters params;
+    Axis x;  // along rows (i), derivative of H_y and of E_z into H_y
+    Axis y;  // along columns (j), derivative of H_x and of E_z into H_x
+
+    // psi fields: the x pair covers whole slab rows, the y pair the slab
+    // columns of every row.
+    Linear2DVector<Compute> psiEzx, psiHyx;
+    Linear2DVector<Compute> psiEzy, psiHxy;
+};
+
+#endif
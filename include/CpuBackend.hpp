@@ -0,0 +1,94 @@
+#ifndef CPU_BACKEND_HPP
+#define CPU_BACKEND_HPP
+
+#include <vector>
+
+#include "ActivityMap.hpp"
+#include "Backend.hpp"
+#include "Kernels.hpp"
+#include "ThreadPool.hpp"
+
+// FDTD update running on the host, directly on the Simulation's vectors.
+// Each half-step is split into contiguous row bands, one per worker of a
+// persistent thread pool; a half-step returns only when every band is
+// done, so the E and H updates never overlap. Rows are updated with the
+// SIMD kernels chosen by selectKernels().
+//
+// advance() additionally tiles in time: the grid is cut into bands of
+// rows and each band is carried through several steps while it sits in
+// L2. Bands are skewed back one row per step so a band only ever waits on
+// the band above it, which lets workers run bands as a pipeline. The
+// result is identical to stepping one half-step at a time.
+//
+// advance() also skips tiles whose fields are still zero, tracked in an
+// ActivityMap that is rebuilt every kTileSize / 2 steps; early steps of a
+// large run and sparse scenes only pay for the region the wave reached.
+template <typename Storage, typename Compute>
+class BasicCpuBackend : public BasicBackend<Storage, Compute> {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+    using Kernels = KernelTable<Storage, Compute>;
+
+    // threads <= 0 uses one worker per hardware thread; firstCpu >= 0 pins
+    // the workers, see ThreadPool.
+    explicit BasicCpuBackend(Simulation &sim, int threads = 0, int firstCpu = -1);
+
+    const char *name() const override { return "cpu"; }
+
+    void stepElectricField() override;
+    void stepMagneticField() override;
+
+    void advance(int steps) override;
+
+    Storage *electricField() override;
+    std::uint8_t *materialField() override;
+
+    void fieldsChanged() override { rescanAll = true; }
+
+    int threadCount() const { return pool.size(); }
+
+    const char *isa() const { return kernels->isa; }
+    void setKernels(const Kernels &table) { kernels = &table; }
+
+    // Steps each band is advanced by before moving on; <= 1 disables
+    // tiling. rowsPerTile <= 0 sizes bands to fit in L2.
+    void setTiling(int stepsPerTile, int rowsPerTile = 0);
+
+    // Skipping of quiescent tiles, on by default. threshold > 0 also
+    // counts fields of at most that magnitude as quiescent, which trades
+    // exactness for speed.
+    void setActivityTracking(bool enabled, double threshold = 0.0);
+    // Share of tiles the last advance() updated.
+    double activeFraction() const { return activity.fraction(); }
+
+private:
+    void updateElectricRows(int rowBegin, int rowEnd);
+    void updateMagneticRows(int rowBegin, int rowEnd);
+
+    // Steps firstLevel up to firstLevel + steps of the advance() call,
+    // which is what the sources, probes and DFT monitors count in.
+    void advanceStepwise(int firstLevel, int steps);
+    void advanceTiled(int firstLevel, int steps);
+    int bandRows(int depth) const;
+    void refreshActivity();
+    bool tileIsQuiet(int ti, int tj) const;
+
+    using BasicBackend<Storage, Compute>::sim;
+
+    ThreadPool pool;
+    const Kernels *kernels;
+
+    int tileSteps{8};
+    int tileRows{0};
+
+    ActivityMap activity;
+    std::vector<std::uint8_t> tileActive;
+    bool trackActivity{true};
+    double activityThreshold{0.0};
+    // Set when the fields may be nonzero outside the active tiles.
+    bool rescanAll{true};
+};
+
+using CpuBackend = BasicCpuBackend<float, float>;
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef DFT_MONITORS_HPP
+#define DFT_MONITORS_HPP
+
+// Running discrete Fourier transforms of a field over rectangular regions,
+// for frequency-domain results without storing the time series. After
+// every step each monitored cell adds x(t) exp(-i 2 pi f t) dt for each of
+// its frequencies, where t is the time E_z was driven at in that step and
+// half a step later for H_x and H_y.
+//
+// Like the probes, the sums are updated by the backend for the rows it
+// has just written, while they are still in cache, with the dftRow kernel
+// of selectKernels(). The phase factors are worked out once per advance()
+// call: one sin/cos per frequency for the first step and a complex
+// rotation by exp(-i 2 pi f dt) for the rest.
+//
+// Output file: a header ("EMSIMDFT", version, field, region i0 j0 i1 j1,
+// frequency count, steps summed), the frequencies as float64, then per
+// frequency the real and then the imaginary parts of the region as
+// row-major float32. Values are stored in host byte order.
+
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "ConductorMask.hpp"
+#include "FieldComponent.hpp"
+#include "Kernels.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+struct DftMonitor {
+    std::string name;
+    FieldComponent field;
+    MaskRect region;
+    std::vector<double> frequencies;  // cycles per unit of simulated time
+};
+
+template <typename Storage, typename Compute>
+class BasicDftMonitorSet {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    explicit BasicDftMonitorSet(Simulation &sim) : sim(sim) {}
+
+    BasicDftMonitorSet(const BasicDftMonitorSet&) = delete;
+    BasicDftMonitorSet& operator=(const BasicDftMonitorSet&) = delete;
+
+    // Registers a monitor of field over region and returns its index, or
+    // -1 if the region is empty or leaves the grid, or no frequency is
+    // given.
+    int add(const std::string &name, FieldComponent field, const MaskRect &region,
+        const std::vector<double> &frequencies);
+    void clear();
+
+    bool empty() const { return monitors.empty(); }
+    int monitorCount() const { return static_cast<int>(monitors.size()); }
+    const DftMonitor &monitor(int m) const { return monitors[m]; }
+
+    // Transform of monitor m at its frequency f in cell (i, j) of the grid.
+    std::complex<double> value(int m, int f, int i, int j) const;
+
+    // Steps summed since the monitors were added or reset.
+    long steps() const { return stepsDone; }
+    void reset();
+
+    // Monitor m's running sums: per frequency the real and then the
+    // imaginary parts of the region, row-major. For checkpoints.
+    std::vector<Compute> &sums(int m) { return accumulators[m]; }
+    void setSteps(long steps) { stepsDone = steps; }
+
+    bool write(int m, const std::string &path, std::string &error) const;
+
+    // Called by Simulation::advance() around the backend: prepare() works
+    // out the phase factors for up to steps steps starting at startTime
+    // and returns how many the backend may take, commit() counts them.
+    int prepare(int steps, double startTime);
+    void commit(int steps) { stepsDone += steps; }
+
+    // Called by backends once rows [rowBegin, rowEnd) are final for the
+    // level-th step since prepare(). E_z rows 0 and M-1 are never updated
+    // and are summed along with rows 1 and M-2.
+    void accumulateElectricRows(int level, int rowBegin, int rowEnd);
+    void accumulateMagneticRows(int level, int rowBegin, int rowEnd);
+
+private:
+    // Steps one prepare() covers, which bounds the phase tables.
+    static constexpr int kMaxLevels = 1024;
+
+    void accumulate(FieldComponent field, int level, int rowBegin, int rowEnd);
+
+    Simulation &sim;
+    const KernelTable<Storage, Compute> &kernels{selectKernels<Storage, Compute>()};
+
+    std::vector<DftMonitor> monitors;
+    std::vector<std::vector<Compute>> accumulators;
+    // Monitor m's frequencies are entries firstFrequency[m] on of each
+    // level's row of the phase tables, which hold dt cos and -dt sin of
+    // the phase as pairs.
+    std::vector<int> firstFrequency{0};
+    std::vector<Compute> electricPhases, magneticPhases;
+    long stepsDone{0};
+};
+
+#endif
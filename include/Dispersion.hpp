@@ -0,0 +1,137 @@
+#ifndef DISPERSION_HPP
+#define DISPERSION_HPP
+
+// Dispersive materials through auxiliary differential equations. A
+// material keeps its coefficient table entry, whose epsr is the
+// permittivity at infinite frequency, and gains up to kMaxPoles poles.
+// Each pole carries a polarization P, in units of E_z, which follows
+//
+//   Drude:    P'' + gamma P'                 = (2 pi fp)^2 E
+//   Lorentz:  P'' + gamma P' + (2 pi f0)^2 P = deltaEpsilon (2 pi f0)^2 E
+//   Debye:    tau P' + P                     = deltaEpsilon E
+//
+// and enters the E_z update through P[n+1] - P[n]. The equations are
+// stepped with the bilinear transform, so P[n+1] depends on E[n+1] and
+// the update of a dispersive cell is implicit: the backend's kernels
+// compute the plain update E*, and a second pass solves
+//
+//   E[n+1] = E* - sum(P[n+1] - P[n]) / (epsr (1 + loss))
+//
+// for E[n+1] cell by cell. The transform keeps every pole passive, so the
+// solver stays stable up to its usual Courant limit, which an explicit
+// drive would not. Poles only look at their own cell, so the pass runs
+// right after the E_z update of a band of rows and follows the backend's
+// tiling. Sources and the plane wave write their cells after it and reach
+// the poles a step later.
+//
+// State is only kept for the cells of dispersive materials, which are
+// usually a few percent of the grid. Each such material's cells are
+// listed by row and column, and every per-cell quantity is a contiguous
+// array over those cells, so the pole updates are dense vector loops
+// (KernelTable::poleHistory and poleStep) and only E_z is gathered and
+// scattered.
+
+#include <string>
+#include <vector>
+
+#include "ConductorMask.hpp"
+#include "Kernels.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+struct DispersivePole {
+    enum class Kind { Drude, Lorentz, Debye };
+
+    Kind kind{Kind::Lorentz};
+    double deltaEpsilon{0.0};    // Lorentz and Debye
+    double frequency{0.0};       // Drude: plasma frequency; Lorentz: resonance
+    double damping{0.0};         // Drude and Lorentz: gamma, per unit time
+    double relaxationTime{1.0};  // Debye: tau
+};
+
+// Parses "drude", "lorentz" or "debye".
+bool parseDispersivePoleKind(const std::string &name, DispersivePole::Kind &kind);
+
+template <typename Storage, typename Compute>
+class BasicDispersion {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    static constexpr int kMaxPoles = 4;
+
+    explicit BasicDispersion(Simulation &sim) : sim(sim) {}
+
+    BasicDispersion(const BasicDispersion&) = delete;
+    BasicDispersion& operator=(const BasicDispersion&) = delete;
+
+    // Adds a pole to material, which must not be vacuum. Returns false
+    // for an unknown material, a full one, or a pole with a non-positive
+    // strength, frequency or relaxation time or negative damping. Resets
+    // the material's polarization.
+    bool addPole(int material, const DispersivePole &pole);
+    // Removes every pole and all polarization.
+    void clear();
+
+    bool empty() const { return groups.empty(); }
+    // Cells holding polarization, as of the last refresh().
+    int cellCount() const { return static_cast<int>(columns.size()); }
+    // Smallest rectangle holding them.
+    const MaskRect &bounds() const { return cellBounds; }
+
+    // Called by Simulation after cells changed material. Polarization of
+    // cells that keep their material carries over.
+    void materialsChanged() { stale = true; }
+
+    // Relists the cells if materials changed and recomputes the
+    // coefficients. Backends call it before updating, with no rows in
+    // flight.
+    void refresh();
+
+    // Called by the CPU backend right after the E_z update of rows
+    // [rowBegin, rowEnd), within [1, M-1). Rows are independent, so the
+    // range may be split between threads.
+    void correctElectricRows(const KernelTable<Storage, Compute> &kernels, int rowBegin, int rowEnd);
+
+    // The per-cell state, which checkpoints save. Its layout follows from
+    // the material ids, so refresh() before restoring it.
+    std::vector<Compute> &state() { return polarization; }
+
+private:
+    struct Pole {
+        DispersivePole pole;
+        PoleCoefficients<Compute> step;
+    };
+
+    // The cells of one dispersive material. Cell k of the material is
+    // columns[first + k]; row i's are rowFirst[i] up to rowFirst[i+1].
+    struct Group {
+        int material;
+        std::vector<Pole> poles;
+        int first, count;
+        std::vector<int> rowFirst;
+        // Into polarization: count values of E_z after the last pass,
+        // then P and carry of each pole.
+        std::size_t state;
+        // E[n+1] = solve E* - solveHistory sum(history)
+        Compute solve, solveHistory;
+    };
+
+    void rebuild();
+    Compute *array(const Group &group, int a) {
+        return polarization.data() + group.state + static_cast<std::size_t>(a) * group.count;
+    }
+
+    Simulation &sim;
+    std::vector<Group> groups;
+    bool stale{true};
+
+    std::vector<int> columns;
+    std::vector<Compute> polarization;
+    // Per cell scratch of the pass: the sum of the poles' history, and
+    // E[n+1].
+    std::vector<Compute> history, electric;
+    MaskRect cellBounds{};
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef FIELD_COMPONENT_HPP
+#define FIELD_COMPONENT_HPP
+
+#include <string>
+
+// The field arrays of a Simulation, for code that records them.
+enum class FieldComponent { Ez, Hx, Hy };
+
+constexpr int kFieldComponentCount = 3;
+
+inline const char *fieldComponentName(FieldComponent component) {
+    static const char *const names[kFieldComponentCount] = {"ez", "hx", "hy"};
+    return names[static_cast<int>(component)];
+}
+
+// Parses "ez", "hx" or "hy".
+inline bool parseFieldComponent(const std::string &name, FieldComponent &component) {
+    for (int c = 0; c < kFieldComponentCount; c++) {
+        if (name == fieldComponentName(static_cast<FieldComponent>(c))) {
+            component = static_cast<FieldComponent>(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef FIELD_RENDERER_HPP
+#define FIELD_RENDERER_HPP
+
+// Draws E_z as one texture: every cell is colormapped into an RGBA pixel
+// buffer, which is uploaded once per frame and stretched over the window
+// by a single sprite. The colormap pass runs on a caller-owned pool in
+// chunks of whole rows that start on a cache line, so no two workers
+// write to the same line of the buffer.
+
+#include <cstdint>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "Colormap.hpp"
+#include "ConductorMask.hpp"
+#include "Linear2DVector.hpp"
+#include "ThreadPool.hpp"
+
+class FieldRenderer {
+public:
+    FieldRenderer(int rows, int cols, float width, float height);
+
+    FieldColorizer &colorizer() { return colors; }
+
+    // Colormaps field, whose element (i, j) is at field[i * pitch + j],
+    // and copies the result into the texture. Conductor cells are drawn
+    // magenta.
+    void update(const float *field, int pitch, const ConductorMask &conductor, ThreadPool &pool);
+
+    void draw(sf::RenderWindow &window) const;
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+private:
+    int rows_, cols_;
+    FieldColorizer colors;
+    int chunkRows;
+    std::vector<std::uint32_t, AlignedAllocator<std::uint32_t>> pixels;
+    sf::Texture texture;
+    sf::Sprite sprite;
+};
+
+#endif
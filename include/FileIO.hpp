@@ -0,0 +1,41 @@
+#ifndef FILE_IO_HPP
+#define FILE_IO_HPP
+
+// Whole transfers at an explicit offset for the file formats. pwrite and
+// pread may move fewer bytes than asked for, so these loop until all of
+// them are through; both return false on an error or at the end of the
+// file. Neither moves the descriptor's file position.
+
+#include <cstdint>
+
+#include <unistd.h>
+
+inline bool writeAll(int fd, const void *data, std::uint64_t bytes, std::uint64_t offset) {
+    const char *p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t written = ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        bytes -= written;
+        offset += written;
+    }
+    return true;
+}
+
+inline bool readAll(int fd, void *data, std::uint64_t bytes, std::uint64_t offset) {
+    char *p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t got = ::pread(fd, p, bytes, static_cast<off_t>(offset));
+        if (got <= 0) {
+            return false;
+        }
+        p += got;
+        bytes -= got;
+        offset += got;
+    }
+    return true;
+}
+
+#endif
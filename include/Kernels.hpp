@@ -0,0 +1,156 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+// Row kernels for the 2D TMz update and the 3D Yee update. Every
+// instruction set provides the same functions; selectKernels() picks the
+// widest one the CPU supports at run time. Kernels are templated on the
+// storage type of the fields and the type the update is computed in.
+//
+// Each update comes in two forms: a mixed one that looks the
+// coefficients up per cell through the material index, and a uniform one
+// for spans of a single material that takes them as scalars and reads
+// nothing but the fields.
+//
+// Row pointers come from Linear2DVector, so they are 64-byte aligned and
+// the reads one column or row past the edge land in the halo.
+
+#include <cstdint>
+
+#include "ConductorMask.hpp"
+#include "Material.hpp"
+#include "Precision.hpp"
+
+// Operands of one E_z row update, all indexed by column.
+template <typename Storage, typename Compute>
+struct ElectricRow {
+    Storage *ez;
+    const Storage *hy;      // H_y row mm
+    const Storage *hyPrev;  // H_y row mm-1
+    const Storage *hx;      // H_x row mm, read at nn and nn-1
+    const std::uint8_t *material;
+    const ConductorMask::Word *conductor;  // cells whose bit is set are forced to 0
+    const Compute *coefficients;  // eze at [kCoefficientStride * id], ezh next to it
+};
+
+// Operands of one H_x or H_y row update.
+template <typename Storage, typename Compute>
+struct MagneticRow {
+    Storage *h;
+    const Storage *ez;      // E_z row mm
+    const Storage *ezNext;  // H_y: E_z row mm+1, unused for H_x
+    const std::uint8_t *material;
+    const Compute *coefficients;  // chh at [kCoefficientStride * id], che next to it
+};
+
+// Operands of one row of a 3D component update (Simulation3D.hpp), all
+// indexed by column: f = c0 f + c1 ((a - aPrev) - (b - bPrev)). Each
+// difference is between two rows or planes, or along the row through
+// pointers one column apart, so every component of E and H fits.
+template <typename Storage, typename Compute>
+struct CurlRow {
+    Storage *f;
+    const Storage *a, *aPrev;
+    const Storage *b, *bPrev;
+    const std::uint8_t *material;
+    const Compute *coefficients;  // c0 at [kCoefficientStride * id], c1 next to it
+};
+
+// One dispersive pole in the recursion of Dispersion.hpp:
+//   P[n+1] = alpha P[n] + carry[n] + drive E[n+1]
+//   carry[n+1] = xi P[n] + lead E[n+1] + lag E[n]
+template <typename Compute>
+struct PoleCoefficients {
+    Compute alpha, xi;
+    Compute drive, lead, lag;
+};
+
+template <typename Storage, typename Compute>
+struct KernelTable {
+    using Electric = ElectricRow<Storage, Compute>;
+    using Magnetic = MagneticRow<Storage, Compute>;
+    using Curl = CurlRow<Storage, Compute>;
+
+    const char *isa;
+    // Columns [begin, end) of one row.
+    void (*electricRow)(const Electric &row, int begin, int end);
+    void (*magneticXRow)(const Magnetic &row, int begin, int end);
+    void (*magneticYRow)(const Magnetic &row, int begin, int end);
+    // Same, for a span of one material and no conductors.
+    void (*electricRowUniform)(const Electric &row, Compute ce, Compute ch, int begin, int end);
+    void (*magneticXRowUniform)(const Magnetic &row, Compute hh, Compute he, int begin, int end);
+    void (*magneticYRowUniform)(const Magnetic &row, Compute hh, Compute he, int begin, int end);
+    // Running DFT of n cells: re[k] += cosine * field[k], im[k] += sine * field[k].
+    void (*dftRow)(const Storage *field, Compute *re, Compute *im, Compute cosine, Compute sine, int n);
+    // One pole over n dispersive cells, either side of the E_z solve.
+    // poleHistory adds the part of P[n+1] - P[n] known before it to
+    // history; poleStep advances P and carry given E[n+1] (e) and E[n]
+    // (previous).
+    void (*poleHistory)(const Compute *polarization, const Compute *carry, Compute *history,
+        const PoleCoefficients<Compute> &pole, int n);
+    void (*poleStep)(Compute *polarization, Compute *carry, const Compute *e, const Compute *previous,
+        const PoleCoefficients<Compute> &pole, int n);
+    // Columns [begin, end) of one row of a 3D component, with per-cell
+    // coefficients or, for a span of one material, scalar ones.
+    void (*curlRow)(const Curl &row, int begin, int end);
+    void (*curlRowUniform)(const Curl &row, Compute c0, Compute c1, int begin, int end);
+};
+
+// Best kernels for this CPU. The EMSIM_ISA environment variable
+// (scalar, avx2, avx512, neon) forces a narrower set for comparison.
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> &selectKernels();
+
+// Kernels for one instruction set (nullptr: the widest available), or
+// nullptr if it was not compiled in, the CPU lacks it or it has no
+// kernels for this precision.
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> *findKernels(const char *isa);
+
+// Per instruction set tables, nullptr where a precision is not covered.
+// Each is defined in its own translation unit.
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> *scalarKernels();
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> *avx2Kernels();
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> *avx512Kernels();
+template <typename Storage, typename Compute>
+const KernelTable<Storage, Compute> *neonKernels();
+
+// Field to colour conversion for Colormap: every value is mapped to a
+// table index, index = clamp(value * scale + offset, 0, maxIndex)
+// truncated, and replaced by conductorColor where conductor is nonzero.
+// Pixels are packed RGBA (see Colormap.hpp).
+struct ColorizeParams {
+    const std::uint32_t *lut;
+    float scale, offset, maxIndex;
+    std::uint32_t conductorColor;
+};
+
+struct ColorizeTable {
+    const char *isa;
+    // n values; conductor may be nullptr.
+    void (*colorizeRow)(const float *values, const ConductorMask::Word *conductor, std::uint32_t *out, int n,
+        const ColorizeParams &params);
+};
+
+inline std::uint32_t colorizeValue(float value, bool conductor, const ColorizeParams &params) {
+    if (conductor) {
+        return params.conductorColor;
+    }
+    float t = value * params.scale + params.offset;
+    t = t > 0.0f ? t : 0.0f;  // also catches NaN
+    t = t < params.maxIndex ? t : params.maxIndex;
+    return params.lut[static_cast<int>(t)];
+}
+
+// Same selection rules as selectKernels().
+const ColorizeTable &selectColorizer();
+const ColorizeTable *findColorizer(const char *isa);
+
+const ColorizeTable *scalarColorizer();
+const ColorizeTable *avx2Colorizer();
+const ColorizeTable *avx512Colorizer();
+const ColorizeTable *neonColorizer();
+
+#endif
@@ -4,29 +4,113 @@
 // Class to access a grid of elements where
 // the data is stored as one contiguous block.
 // Makes it easier to do GPU processing.
+//
+// Rows start on a 64-byte boundary and are pitch() elements apart. The
+// grid is surrounded by halo() ghost rows and columns on every side, so
+// get(-1, j) and get(i, cols()) are valid; ghost cells are zero unless
+// written. Row padding beyond the halo is never read by the solver.
+//
+// The storage starts on a kMappableAlignment boundary and owns whole
+// multiples of it, so a checkpoint can map a file over it in place.
 
+#include <algorithm>
+#include <cstddef>
+#include <new>
 #include <vector>
 
-#define DECIMAL float
+constexpr std::size_t kGridAlignment = 64;
+// Largest page size in use (Apple silicon), see Checkpoint.hpp.
+constexpr std::size_t kMappableAlignment = 16384;
+
+template <typename T, std::size_t Alignment = kGridAlignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    // Whole multiples of Alignment, so nothing else shares the last one.
+    T* allocate(std::size_t n) {
+        const std::size_t bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+};
 
 template <typename T>
 class Linear2DVector {
 
 public:
-    std::vector<T> data;
-
-    Linear2DVector(int rows, int cols) {
+    // pitch <= 0 picks the smallest aligned pitch that fits the row and
+    // its halo; a larger pitch can be requested to avoid cache aliasing.
+    Linear2DVector(int rows, int cols, int halo = 1, int pitch = 0) {
         rows_ = rows;
         cols_ = cols;
-        data = std::vector<T>(rows * cols);
+        halo_ = halo;
+
+        const int perLine = std::max<int>(1, kGridAlignment / sizeof(T));
+        auto roundUp = [perLine](int n) { return (n + perLine - 1) / perLine * perLine; };
+
+        // Column 0 is aligned, with the left halo in the padding before it.
+        leftPad_ = roundUp(halo);
+        pitch_ = roundUp(std::max(pitch, leftPad_ + cols + halo));
+        origin_ = static_cast<std::size_t>(halo) * pitch_ + leftPad_;
+        data_ = std::vector<T, AlignedAllocator<T, kMappableAlignment>>(static_cast<std::size_t>(pitch_) * (rows + 2 * halo), T());
     }
 
     T& get(int i, int j) {
-        return data[i* cols_ + j];
+        return data_[origin_ + static_cast<std::ptrdiff_t>(i) * pitch_ + j];
+    }
+
+    const T& get(int i, int j) const {
+        return data_[origin_ + static_cast<std::ptrdiff_t>(i) * pitch_ + j];
+    }
+
+    // Element (i, 0); valid for i in [-halo(), rows() + halo()).
+    T* row(int i) {
+        return data_.data() + origin_ + static_cast<std::ptrdiff_t>(i) * pitch_;
+    }
+
+    const T* row(int i) const {
+        return data_.data() + origin_ + static_cast<std::ptrdiff_t>(i) * pitch_;
+    }
+
+    // Element (0, 0); element (i, j) is at origin()[i * pitch() + j].
+    T* origin() { return row(0); }
+    const T* origin() const { return row(0); }
+
+    // The whole allocation including halos and padding, for bulk copies.
+    T* storage() { return data_.data(); }
+    const T* storage() const { return data_.data(); }
+    std::size_t storageSize() const { return data_.size(); }
+    std::size_t originOffset() const { return origin_; }
+
+    void fill(const T& value) {
+        std::fill(data_.begin(), data_.end(), value);
     }
 
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int halo() const { return halo_; }
+    int pitch() const { return pitch_; }
+
 private:
-    int rows_, cols_;
+    int rows_, cols_, halo_, pitch_, leftPad_;
+    std::size_t origin_;
+    std::vector<T, AlignedAllocator<T, kMappableAlignment>> data_;
 };
 
 #endif
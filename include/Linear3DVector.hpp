@@ -0,0 +1,109 @@
+#ifndef LINEAR3DVECTOR_HPP
+#define LINEAR3DVECTOR_HPP
+
+// Three-dimensional counterpart of Linear2DVector: layers() planes of
+// rows() x cols() elements. Every plane is laid out like a Linear2DVector
+// (column 0 aligned, rows pitch() elements apart, halo() ghost rows and
+// columns), planes are planePitch() elements apart, and halo() ghost
+// planes lie before the first and after the last, so row(-1, i) and
+// row(layers(), i) are valid. Offsets are 64-bit, so one field may hold
+// far more than 2^31 elements.
+//
+// The storage is not initialized. Clear it with fill(), or plane by plane
+// with fillPlanes() from the threads that will work on those planes, so
+// that the operating system places each plane's pages near its thread.
+
+#include <algorithm>
+#include <cstddef>
+
+#include "Linear2DVector.hpp"
+
+template <typename T>
+class Linear3DVector {
+
+public:
+    // pitch <= 0 picks the smallest aligned pitch that fits the row and
+    // its halo, as for Linear2DVector.
+    Linear3DVector(int layers, int rows, int cols, int halo = 1, int pitch = 0) {
+        layers_ = layers;
+        rows_ = rows;
+        cols_ = cols;
+        halo_ = halo;
+
+        const int perLine = std::max<int>(1, kGridAlignment / sizeof(T));
+        auto roundUp = [perLine](int n) { return (n + perLine - 1) / perLine * perLine; };
+
+        leftPad_ = roundUp(halo);
+        pitch_ = roundUp(std::max(pitch, leftPad_ + cols + halo));
+        planePitch_ = static_cast<std::size_t>(pitch_) * (rows + 2 * halo);
+        origin_ = static_cast<std::size_t>(halo) * planePitch_ + static_cast<std::size_t>(halo) * pitch_ + leftPad_;
+        size_ = planePitch_ * (layers + 2 * halo);
+        data_ = Allocator().allocate(size_);
+    }
+
+    ~Linear3DVector() {
+        Allocator().deallocate(data_, size_);
+    }
+
+    Linear3DVector(const Linear3DVector&) = delete;
+    Linear3DVector& operator=(const Linear3DVector&) = delete;
+
+    T& get(int l, int i, int j) {
+        return row(l, i)[j];
+    }
+
+    const T& get(int l, int i, int j) const {
+        return row(l, i)[j];
+    }
+
+    // Element (l, i, 0); valid for l in [-halo(), layers() + halo()) and
+    // i in [-halo(), rows() + halo()).
+    T* row(int l, int i) {
+        return data_ + offset(l, i);
+    }
+
+    const T* row(int l, int i) const {
+        return data_ + offset(l, i);
+    }
+
+    // Element (l, 0, 0); element (l, i, j) is at plane(l)[i * pitch() + j].
+    T* plane(int l) { return row(l, 0); }
+    const T* plane(int l) const { return row(l, 0); }
+
+    // The whole allocation including halos and padding, for bulk copies.
+    T* storage() { return data_; }
+    const T* storage() const { return data_; }
+    std::size_t storageSize() const { return size_; }
+
+    void fill(const T& value) {
+        std::fill(data_, data_ + size_, value);
+    }
+
+    // Fills planes [begin, end) with their ghost rows and padding, within
+    // [-halo(), layers() + halo()).
+    void fillPlanes(int begin, int end, const T& value) {
+        std::fill(data_ + static_cast<std::size_t>(begin + halo_) * planePitch_,
+            data_ + static_cast<std::size_t>(end + halo_) * planePitch_, value);
+    }
+
+    int layers() const { return layers_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int halo() const { return halo_; }
+    int pitch() const { return pitch_; }
+    std::size_t planePitch() const { return planePitch_; }
+
+private:
+    using Allocator = AlignedAllocator<T, kMappableAlignment>;
+
+    std::ptrdiff_t offset(int l, int i) const {
+        const std::ptrdiff_t planePitch = static_cast<std::ptrdiff_t>(planePitch_);
+        return static_cast<std::ptrdiff_t>(origin_) + l * planePitch + static_cast<std::ptrdiff_t>(i) * pitch_;
+    }
+
+    int layers_, rows_, cols_, halo_, pitch_, leftPad_;
+    std::size_t planePitch_, origin_, size_;
+    T *data_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MATERIAL_HPP
+#define MATERIAL_HPP
+
+// Per-cell material indices and the coefficient table they refer to.
+// Instead of six full-size coefficient arrays, every cell stores one
+// byte naming its material, and rows are summarized as spans of cells
+// that can share scalar coefficients.
+
+#include <cstdint>
+#include <vector>
+
+#include "ConductorMask.hpp"
+
+// Update coefficients of one material. Kept as six consecutive values so
+// kernels can index a table of them with a fixed stride.
+template <typename Compute>
+struct MaterialCoefficients {
+    Compute eze, ezh;  // E_z = eze * E_z + ezh * curl H
+    Compute hxh, hxe;  // H_x = hxh * H_x - hxe * dE_z/dy
+    Compute hyh, hye;  // H_y = hyh * H_y + hye * dE_z/dx
+};
+
+// A material as the user describes it. The conductivities enter as their
+// loss per half step, sigma * deltaT / (2 eps) for the electric one and
+// sigma_m * deltaT / (2 mu) for the magnetic one; 0 is lossless.
+struct MaterialProperties {
+    double epsr{1.0};
+    double mur{1.0};
+    double electricLoss{0.0};
+    double magneticLoss{0.0};
+};
+
+// Coefficients of properties on a grid with Courant number cdtds and
+// free-space impedance imp0. Vacuum gives the plain update, so sharing
+// the table costs lossless cells nothing.
+template <typename Compute>
+MaterialCoefficients<Compute> compileMaterial(const MaterialProperties &properties, Compute cdtds, Compute imp0) {
+    const double e = properties.electricLoss, h = properties.magneticLoss;
+    MaterialCoefficients<Compute> c;
+    c.eze = Compute((1.0 - e) / (1.0 + e));
+    c.ezh = Compute(cdtds * imp0 / properties.epsr / (1.0 + e));
+    c.hxh = Compute((1.0 - h) / (1.0 + h));
+    c.hxe = Compute(cdtds / imp0 / properties.mur / (1.0 + h));
+    c.hyh = c.hxh;
+    c.hye = c.hxe;
+    return c;
+}
+
+constexpr int kCoefficientStride = 6;
+constexpr int kMaxMaterials = 256;
+
+// Columns [begin, end) of a row that take the same update path.
+struct RowSpan {
+    // Material index when every cell in the span shares it, otherwise
+    // one of the markers below.
+    static constexpr int kMixed = -1;      // per-cell lookup
+    static constexpr int kConductor = -2;  // E_z forced to 0
+
+    int begin, end;
+    int material;
+};
+
+// Splits a row of n cells into spans. Runs of one material (or, when a
+// conductor mask row is given, of conductor cells) at least minRun long
+// become their own span; everything in between is merged into kMixed
+// spans.
+void buildRowSpans(const std::uint8_t *material, const ConductorMask::Word *conductor, int n, int minRun,
+    std::vector<RowSpan> &spans);
+
+#endif
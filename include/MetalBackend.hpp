@@ -0,0 +1,52 @@
+#ifndef METAL_BACKEND_HPP
+#define METAL_BACKEND_HPP
+
+#include <Metal/Metal.hpp>
+#include <QuartzCore/QuartzCore.hpp>
+#include <Foundation/Foundation.hpp>
+
+#include "Backend.hpp"
+
+// Runs the field updates as Metal compute kernels. The fields are copied
+// into shared buffers when the backend is created, so the host vectors of
+// the Simulation are only current after synchronize().
+class MetalBackend : public Backend {
+public:
+    explicit MetalBackend(Simulation &sim);
+
+    ~MetalBackend();
+
+    const char *name() const override { return "metal"; }
+
+    void stepElectricField() override;
+    void stepMagneticField() override;
+
+    float *electricField() override;
+    std::uint8_t *materialField() override;
+
+    void materialsChanged() override;
+    void conductorsChanged(const MaskRect &rect) override;
+    void fieldsChanged() override;
+
+    void synchronize() override;
+
+private:
+    MTL::Device *device;
+
+    MTL::Buffer *bufferE_z;
+    MTL::Buffer *bufferH_x;
+    MTL::Buffer *bufferH_y;
+
+    MTL::Buffer *bufferMaterial;
+    MTL::Buffer *bufferMaterials;
+    MTL::Buffer *bufferLayout;
+
+    MTL::Buffer *bufferConductors;
+
+    MTL::Library *library;
+    NS::Error *error;
+    MTL::Function *eFieldFunction;
+    MTL::Function *hFieldFunction;
+};
+
+#endif
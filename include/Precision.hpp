@@ -0,0 +1,120 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+// Number formats the solver can store its fields in. Half and BFloat16
+// are storage-only: they convert to and from float and every update is
+// computed in float.
+
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+// IEEE 754 binary16, round-to-nearest-even on conversion.
+struct Half {
+    std::uint16_t bits;
+
+    Half() = default;
+
+    Half(float value) : bits(fromFloat(value)) {}
+
+    operator float() const { return toFloat(bits); }
+
+    static std::uint16_t fromFloat(float value) {
+        // Scaling by 2^112 and back rounds the mantissa into place with the
+        // FPU's own rounding, including for results that become subnormal.
+        const float scaleToInf = 0x1.0p+112f;
+        const float scaleToZero = 0x1.0p-110f;
+        float base = ((value < 0 ? -value : value) * scaleToInf) * scaleToZero;
+
+        const std::uint32_t w = std::bit_cast<std::uint32_t>(value);
+        const std::uint32_t shl1 = w + w;
+        const std::uint32_t sign = w & 0x80000000u;
+        std::uint32_t bias = shl1 & 0xFF000000u;
+        if (bias < 0x71000000u) {
+            bias = 0x71000000u;
+        }
+
+        base = std::bit_cast<float>((bias >> 1) + 0x07800000u) + base;
+        const std::uint32_t b = std::bit_cast<std::uint32_t>(base);
+        const std::uint32_t nonsign = ((b >> 13) & 0x7C00u) + (b & 0x0FFFu);
+        return static_cast<std::uint16_t>((sign >> 16) | (shl1 > 0xFF000000u ? 0x7E00u : nonsign));
+    }
+
+    static float toFloat(std::uint16_t h) {
+        const std::uint32_t w = static_cast<std::uint32_t>(h) << 16;
+        const std::uint32_t sign = w & 0x80000000u;
+        const std::uint32_t twice = w + w;
+
+        const float normalized = std::bit_cast<float>((twice >> 4) + (0xE0u << 23)) * 0x1.0p-112f;
+        const float denormalized = std::bit_cast<float>((twice >> 17) | (126u << 23)) - 0.5f;
+
+        const std::uint32_t magnitude = twice < (1u << 27)
+            ? std::bit_cast<std::uint32_t>(denormalized)
+            : std::bit_cast<std::uint32_t>(normalized);
+        return std::bit_cast<float>(sign | magnitude);
+    }
+};
+
+// Upper half of a float: float's range with an 8-bit mantissa.
+struct BFloat16 {
+    std::uint16_t bits;
+
+    BFloat16() = default;
+
+    BFloat16(float value) : bits(fromFloat(value)) {}
+
+    operator float() const { return toFloat(bits); }
+
+    static std::uint16_t fromFloat(float value) {
+        std::uint32_t w = std::bit_cast<std::uint32_t>(value);
+        if ((w & 0x7FFFFFFFu) > 0x7F800000u) {
+            return static_cast<std::uint16_t>((w >> 16) | 0x40u);  // keep NaNs quiet
+        }
+        w += 0x7FFFu + ((w >> 16) & 1u);
+        return static_cast<std::uint16_t>(w >> 16);
+    }
+
+    static float toFloat(std::uint16_t b) {
+        return std::bit_cast<float>(static_cast<std::uint32_t>(b) << 16);
+    }
+};
+
+// Arithmetic type used for a storage type when none is given.
+template <typename Storage>
+struct DefaultCompute {
+    using type = Storage;
+};
+
+template <>
+struct DefaultCompute<Half> {
+    using type = float;
+};
+
+template <>
+struct DefaultCompute<BFloat16> {
+    using type = float;
+};
+
+// Short name of a storage type, as used by scenarios and checkpoints.
+template <typename Storage>
+constexpr const char *precisionName() {
+    if constexpr (std::is_same_v<Storage, float>) {
+        return "f32";
+    } else if constexpr (std::is_same_v<Storage, double>) {
+        return "f64";
+    } else if constexpr (std::is_same_v<Storage, Half>) {
+        return "f16";
+    } else {
+        return "bf16";
+    }
+}
+
+// Every (storage, compute) pair the library is built for; used for
+// explicit template instantiation.
+#define EMSIM_FOR_EACH_PRECISION(X) \
+    X(float, float)                 \
+    X(double, double)               \
+    X(Half, float)                  \
+    X(BFloat16, float)
+
+#endif
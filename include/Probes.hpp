@@ -0,0 +1,127 @@
+#ifndef PROBES_HPP
+#define PROBES_HPP
+
+// Field samples at fixed cells, taken after every time step. Probes are
+// registered up front and sorted by field, row and column; the backend
+// gathers the probes of the rows it has just updated while they are still
+// in cache (the CPU backend per band, so temporal tiling keeps working),
+// which costs one load per probe and step whatever the grid size.
+//
+// Samples go into a preallocated ring holding capacity() steps. With an
+// output file open, a full ring is written out as one block before it
+// would overwrite anything; otherwise the oldest samples are dropped.
+//
+// Output file: a header ("EMSIMPRB", version, column count) and one
+// ProbeColumn record per column (name[32], field, i, j), then blocks.
+// A block is "PBLK", its sample count n and the step of its first sample,
+// followed by n float64 times and then each column's n float32 samples in
+// turn. Values are stored in host byte order.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FieldComponent.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+struct ProbeColumn {
+    std::string name;
+    FieldComponent field;
+    int i, j;
+};
+
+template <typename Storage, typename Compute>
+class BasicProbeSet {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    explicit BasicProbeSet(Simulation &sim) : sim(sim) {}
+    ~BasicProbeSet();
+
+    BasicProbeSet(const BasicProbeSet&) = delete;
+    BasicProbeSet& operator=(const BasicProbeSet&) = delete;
+
+    // Registers a probe of field at cell (i, j) and returns its column, or
+    // -1 if the cell is outside the grid. Drops the samples held.
+    int addPoint(const std::string &name, FieldComponent field, int i, int j);
+
+    // Registers one probe per cell of the line from (i0, j0) to (i1, j1),
+    // named name[0], name[1], ..., and returns the first one's column.
+    int addLine(const std::string &name, FieldComponent field, int i0, int j0, int i1, int j1);
+
+    void clear();
+
+    bool empty() const { return columns.empty(); }
+    int columnCount() const { return static_cast<int>(columns.size()); }
+    const ProbeColumn &column(int c) const { return columns[c]; }
+
+    // Steps the ring holds; drops the samples held.
+    void setCapacity(int steps);
+    int capacity() const { return slots; }
+
+    // Samples held, oldest first. Sample k was taken after step
+    // sampleStep(k), at simulated time sampleTime(k).
+    int sampleCount() const { return count; }
+    long sampleStep(int k) const { return stepsDone - count + k + 1; }
+    double sampleTime(int k) const { return times[slot(k)]; }
+    float sample(int k, int column) const { return samples[static_cast<std::size_t>(slot(k)) * columns.size() + column]; }
+    void discard();
+
+    // Steps taken so far; advance() counts on from it. Set it after
+    // restoring a checkpoint.
+    long step() const { return stepsDone; }
+    void setStep(long step) { stepsDone = step; }
+
+    // Starts an output file. With append set an existing file with the
+    // same columns is continued, keeping only whole blocks that end at or
+    // before step keepUntil.
+    bool openOutput(const std::string &path, std::string &error, bool append = false, long keepUntil = 0);
+    // Writes the samples held as a block and empties the ring.
+    bool flush(std::string &error);
+    bool closeOutput(std::string &error);
+
+    // Called by Simulation::advance() around the backend: reserve()
+    // makes room for up to steps samples and returns how many steps the
+    // backend may take, commit() records them.
+    int reserve(int steps);
+    void commit(int steps, double startTime);
+
+    // Called by backends once rows [rowBegin, rowEnd) are final for the
+    // level-th step since reserve(). E_z rows 0 and M-1 are never updated
+    // and are sampled along with rows 1 and M-2.
+    void sampleElectricRows(int level, int rowBegin, int rowEnd);
+    void sampleMagneticRows(int level, int rowBegin, int rowEnd);
+
+private:
+    int slot(int k) const { return (head + k) % slots; }
+    void changed();
+    void rebuild();
+    void gather(FieldComponent field, int level, int rowBegin, int rowEnd);
+    bool writeBlock();
+
+    Simulation &sim;
+
+    std::vector<ProbeColumn> columns;
+    // Probes in (field, row, column) order; field f's probes in row i are
+    // entries rowFirst[f][i] up to rowFirst[f][i+1] of offsets and targets.
+    std::vector<int> rowFirst[kFieldComponentCount];
+    std::vector<std::size_t> offsets;  // i * pitch + j
+    std::vector<int> targets;          // column
+    bool stale{true};
+
+    int slots{4096};
+    int head{0};
+    int count{0};
+    long stepsDone{0};
+    std::vector<float> samples;  // slot-major
+    std::vector<double> times;
+
+    int fd{-1};
+    std::uint64_t writeOffset{0};  // of the next block
+    std::string outputError;
+    std::vector<char> block;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef SCENARIO_HPP
+#define SCENARIO_HPP
+
+// Description of a headless run, read from a plain text file with one
+// directive per line. '#' starts a comment. For example:
+//
+//   grid 1001 1001          # M N
+//   spacing 0.1 0.1         # deltaX deltaY
+//   timestep 0.05
+//   precision f32           # f32, f64, f16 or bf16
+//   backend cpu
+//   threads 0               # 0: one per hardware thread
+//   tiling 8                # steps per time tile, 1 disables
+//   pml 10                  # absorbing layer thickness, 0 for PEC
+//   steps 2000
+//   material glass epsr 2.25 mur 1 loss 0
+//   material ferrite epsr 4 mur 4 loss 0.01 magnetic_loss 0.01
+//   region glass 400 400 600 600        # i0 j0 i1 j1, half-open
+//   dispersion glass lorentz 1.5 0.1 0.01   # MATERIAL lorentz DEPS F0 GAMMA
+//   dispersion gold drude 0.2 0.005         # MATERIAL drude FP GAMMA
+//   dispersion water debye 70 5             # MATERIAL debye DEPS TAU
+//   conductor 100 100 110 500
+//   source 500 500          # built-in hard Ricker source, or none
+//   waveform tone modulated_sine frequency 0.05 delay 60 width 20
+//   waveform rec sampled file pulse.txt interval 0.05   # one value per line
+//   source_point tone 300 500 soft delay 1.5            # [hard|soft]
+//   source_line tone 300 100 300 900 hard amplitude 0.5
+//   source_area tone 10 10 20 20
+//   plane_wave 300 300 700 700 +i   # i0 j0 i1 j1 [+i|-i|+j|-j], TFSF
+//   probe centre 500 500    # NAME I J [ez|hx|hy]
+//   probe_line cut 0 500 1000 500 hy   # one column per cell
+//   probe_interval 1        # rows of probes.csv
+//   probe_format csv        # columnar: every step to probes.emprb
+//   dft slab ez 400 400 600 600 0.05 0.1   # NAME FIELD i0 j0 i1 j1 FREQ...
+//   snapshot_interval 500
+//   snapshot_format chunked # raw: one .f32 file per field and step
+//   snapshot_fields ez hx   # any of ez, hx, hy
+//   image_interval 100
+//   colormap coolwarm
+//   color_range symmetric   # fixed LOW HIGH, symmetric or auto
+//   checkpoint_interval 1000
+//   checkpoint runs/glass.emck  # default: OUTPUT/checkpoint.emck
+//   restart runs/glass.emck     # resume from the saved step
+//   output runs/glass
+//
+// Later lines override earlier ones for the single-valued directives,
+// which is how command-line overrides are applied.
+
+#include <string>
+#include <vector>
+
+struct ScenarioMaterial {
+    std::string name;
+    double epsr{1.0};
+    double mur{1.0};
+    // sigma * deltaT / (2 eps) and sigma_m * deltaT / (2 mu); 0 is
+    // lossless. Equal losses with epsr == mur match vacuum's impedance.
+    double loss{0.0};
+    double magneticLoss{0.0};
+};
+
+// One pole of a material; see Dispersion.hpp.
+struct ScenarioPole {
+    std::string material;
+    std::string kind;  // drude, lorentz or debye
+    double deltaEpsilon{0.0}, frequency{0.0}, damping{0.0}, relaxationTime{1.0};
+};
+
+struct ScenarioRegion {
+    std::string material;  // empty for a conductor
+    int i0, j0, i1, j1;
+};
+
+struct ScenarioProbe {
+    std::string name;
+    std::string field{"ez"};
+    int i, j;
+    int i1{-1}, j1{-1};  // end of a probe_line, -1 for a point
+};
+
+struct ScenarioWaveform {
+    std::string name;
+    std::string shape;
+    double frequency{1.0}, delay{0.0}, width{1.0}, amplitude{1.0};
+    std::string file;  // sampled: one value per line
+    double interval{1.0};
+};
+
+struct ScenarioSource {
+    std::string kind;  // point, line or area
+    std::string waveform;
+    int i0, j0;
+    int i1{-1}, j1{-1};
+    bool hard{false};
+    double amplitude{1.0}, delay{0.0};
+};
+
+struct ScenarioPlaneWave {
+    int i0{0}, j0{0}, i1{0}, j1{0};  // total-field cells; empty for none
+    std::string direction{"+i"};
+};
+
+struct ScenarioDft {
+    std::string name;
+    std::string field;
+    int i0, j0, i1, j1;
+    std::vector<double> frequencies;  // per unit of simulated time
+};
+
+struct Scenario {
+    int M{301}, N{301};
+    double deltaX{0.1}, deltaY{0.1}, deltaT{0.05};
+    std::string precision{"f32"};
+    std::string backend{"cpu"};
+    int threads{0};
+    int tiling{8};
+    int pml{0};
+    int steps{100};
+    int sourceRow{-1}, sourceColumn{-1};  // -1: centre
+    bool pointSource{true};
+    ScenarioPlaneWave planeWave;
+
+    std::vector<ScenarioMaterial> materials;
+    std::vector<ScenarioPole> poles;
+    std::vector<ScenarioRegion> regions;
+    std::vector<ScenarioWaveform> waveforms;
+    std::vector<ScenarioSource> sources;
+    std::vector<ScenarioProbe> probes;
+    std::vector<ScenarioDft> dfts;
+
+    int probeInterval{1};
+    std::string probeFormat{"csv"};
+    int snapshotInterval{0};  // 0: no snapshots
+    std::string snapshotFormat{"raw"};
+    std::vector<std::string> snapshotFields{"ez"};
+    int imageInterval{0};     // 0: no images
+    std::string colormap{"redblue"};
+    std::string colorRange{"fixed"};
+    double colorLow{-0.3}, colorHigh{0.3};
+    int checkpointInterval{0};  // 0: no checkpoints
+    std::string checkpoint;     // empty: checkpoint.emck in output
+    std::string restart;        // checkpoint to resume from, if any
+    std::string output;         // directory; empty writes nothing
+};
+
+// Applies one directive. Returns false and sets error if it is malformed.
+bool parseScenarioLine(const std::string &line, Scenario &scenario, std::string &error);
+
+// Reads a whole file; error names the offending line.
+bool loadScenario(const std::string &path, Scenario &scenario, std::string &error);
+
+// Checks cross references and bounds once everything is parsed.
+bool validateScenario(const Scenario &scenario, std::string &error);
+
+#endif
@@ -1,77 +1,190 @@
 #ifndef SIMULATION_HPP
 #define SIMULATION_HPP
 
-#include <Metal/Metal.hpp>
-#include <QuartzCore/QuartzCore.hpp>
-#include <Foundation/Foundation.hpp>
-
 #include <cmath>
-
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Backend.hpp"
+#include "ConductorMask.hpp"
+#include "Cpml.hpp"
+#include "DftMonitors.hpp"
+#include "Dispersion.hpp"
 #include "Linear2DVector.hpp"
-
-
-class Simulation {
+#include "Material.hpp"
+#include "Precision.hpp"
+#include "Probes.hpp"
+#include "Sources.hpp"
+#include "Tfsf.hpp"
+
+
+// 2D TMz FDTD solver. Fields and coefficients are kept in Storage and
+// every update is computed in Compute, so a reduced-precision run
+// (Half/BFloat16 storage) and a double-precision reference can be built
+// side by side. Instantiated for the pairs in EMSIM_FOR_EACH_PRECISION.
+template <typename Storage, typename Compute = typename DefaultCompute<Storage>::type>
+class BasicSimulation {
 public:
-    Simulation(int m, int n, DECIMAL deltaX, DECIMAL deltaY, DECIMAL deltaT);
+    using storage_type = Storage;
+    using compute_type = Compute;
+    using Backend = BasicBackend<Storage, Compute>;
+
+    // Starts out on the CPU backend; see useBackend().
+    BasicSimulation(int m, int n, Compute deltaX, Compute deltaY, Compute deltaT);
 
-    ~Simulation();
+    ~BasicSimulation();
 
-    DECIMAL deltaX, deltaY, deltaT;
+    Compute deltaX, deltaY, deltaT;
     int M, N;
 
-    DECIMAL imp0{377.0f};
-    DECIMAL Cdtds{1.0f / (DECIMAL) sqrt(2.0f)};
+    // Cell driven by the hard Ricker source, the centre by default. A
+    // negative row turns the source off.
+    int sourceRow, sourceColumn;
+
+    Compute imp0{377.0f};
+    Compute Cdtds{Compute(1) / std::sqrt(Compute(2))};
     int maxTime{300};
-    MTL::Buffer *bufferE_z;
 
-    // User inputted boundary conditions
-    Linear2DVector<char> conductorField;
+    // Simulated time reached by advance().
+    double time{0.0};
+
+    // Perfect conductors placed by the user, one bit per cell. Edit them
+    // through the functions below so the backend and the row spans follow.
+    ConductorMask conductors;
+
+    // Index into materials for every cell. H_x(i, j) and H_y(i, j) use
+    // the material of cell (i, j).
+    Linear2DVector<std::uint8_t> material;
+
+    // Coefficient table, vacuum at index 0.
+    std::vector<MaterialCoefficients<Compute>> materials;
 
-    Linear2DVector<DECIMAL> E_z;
-    Linear2DVector<DECIMAL> H_x;
-    Linear2DVector<DECIMAL> H_y;
+    // Drude, Lorentz and Debye poles of materials in the table; see
+    // Dispersion.hpp. Only the CPU backend applies them.
+    BasicDispersion<Storage, Compute> dispersion{*this};
+
+    // All fields are M x N with one ghost layer. H_x(i, N-1) and
+    // H_y(M-1, j) lie outside the Yee grid and stay zero, since they only
+    // see the PEC boundary of E_z and the zero halo.
+    Linear2DVector<Storage> E_z;
+    Linear2DVector<Storage> H_x;
+    Linear2DVector<Storage> H_y;
+
+    Linear2DVector<Storage> &field(FieldComponent component) {
+        return component == FieldComponent::Ez ? E_z : component == FieldComponent::Hx ? H_x : H_y;
+    }
+
+    // Sources applied in every step of advance(), besides the built-in one.
+    BasicSourceSet<Storage, Compute> sources{*this};
+
+    // Monitors sampled after every step of advance().
+    BasicProbeSet<Storage, Compute> probes{*this};
+    // Frequency-domain monitors, summed after every step of advance().
+    BasicDftMonitorSet<Storage, Compute> dft{*this};
 
     void stepElectricField();
     void stepMagneticField();
-    void stepRickertSource(DECIMAL time, DECIMAL location);
+    void stepRickertSource(Compute time, Compute location);
     void addConductorAt(int i, int j);
     void removeConductorAt(int i, int j);
 
-    void gpuStepElectricField();
-    void gpuStepMagneticField();
-
+    // Bulk conductor edits, clipped to the grid; see ConductorMask.
+    void fillConductors(const MaskRect &rect, bool conductor = true);
+    void clearConductors(const MaskRect &rect) { fillConductors(rect, false); }
+    void fillConductorPolygon(const std::vector<MaskPoint> &vertices, bool conductor = true);
+    void strokeConductors(MaskPoint from, MaskPoint to, double radius, bool conductor = true);
+
+    // Appends a material and returns its index, or -1 once the table
+    // holds kMaxMaterials.
+    int addMaterial(const MaterialCoefficients<Compute> &coefficients);
+    int addMaterial(const MaterialProperties &properties);
+    // Recompiles material id in place. Cells keep their index, so nothing
+    // but the table changes.
+    bool setMaterial(int id, const MaterialProperties &properties);
+    // Assigns id to cell (i, j), or to the cells of rect, clipped to the
+    // grid; an id that is not in the table is ignored. Only rows where a
+    // cell actually changes get their spans rebuilt.
+    void setMaterialAt(int i, int j, int id);
+    void fillMaterial(const MaskRect &rect, int id);
+    MaterialCoefficients<Compute> vacuumCoefficients() const;
+
+    // Replaces the PEC edges with a CPML of parameters.thickness cells
+    // (0 goes back to PEC). Returns false if the layer does not fit, or
+    // would reach into the plane wave's TFSF contour. Only the CPU
+    // backend applies it.
+    bool setAbsorbingBoundary(const CpmlParameters &parameters);
+    BasicCpml<Storage, Compute> *absorbingBoundary() { return cpml.get(); }
+
+    // Launches a plane wave through the edges of parameters.region (an
+    // empty region removes it); see Tfsf.hpp. Returns false if the region
+    // does not fit inside the absorbing boundary, so set that first. Only
+    // the CPU backend applies it.
+    bool setPlaneWave(const TfsfParameters &parameters);
+    BasicTfsf<Storage, Compute> *planeWave() { return tfsf.get(); }
+
+    // Spans of row i for the E_z and the H updates. Rebuilt lazily for
+    // rows whose materials or conductors changed; see refreshRowSpans().
+    const std::vector<RowSpan> &electricSpans(int i) const { return electricRowSpans[i]; }
+    const std::vector<RowSpan> &magneticSpans(int i) const { return magneticRowSpans[i]; }
+    void refreshRowSpans();
+
+    // Runs whole time steps: E update, sources at the current time, H
+    // update. Backends may fuse several steps together.
+    void advance(int steps);
+
+    // The simulated time at the start of each of the next steps from
+    // startTime, and after the last: steps + 1 values. They are summed one
+    // deltaT at a time, which is how the backends advance time, so that
+    // source tables and probe times agree with it to the bit.
+    std::vector<double> stepTimes(double startTime, int steps) const;
+
+    // Value of the hard Ricker source at the given time.
+    Compute rickertSource(Compute time, Compute location) const;
+
+    // Replaces the engine advancing the fields. The new backend starts
+    // from the host vectors, so the old one is synchronized first.
+    template <typename B, typename... Args>
+    void useBackend(Args&&... args) {
+        currentBackend->synchronize();
+        currentBackend = std::make_unique<B>(*this, std::forward<Args>(args)...);
+    }
+    Backend &backend() { return *currentBackend; }
+
+    // E_z as seen by the active backend, element (i, j) at
+    // [i * E_z.pitch() + j].
+    Storage *electricField() { return currentBackend->electricField(); }
+
+    // Brings the host vectors up to date with the active backend.
+    void synchronize() { currentBackend->synchronize(); }
+
+    // Call after writing the host fields, materials or conductors
+    // directly, as a restored checkpoint does: rebuilds every row's spans
+    // and hands the new state to the backend.
+    void stateChanged();
 
 private:
-    Linear2DVector<DECIMAL> C_hxh;
-    Linear2DVector<DECIMAL> C_hxe;
-    Linear2DVector<DECIMAL> C_hyh;
-    Linear2DVector<DECIMAL> C_hye;
-    Linear2DVector<DECIMAL> C_eze;
-    Linear2DVector<DECIMAL> C_ezh;
+    template <typename, typename>
+    friend class BasicCpuBackend;
+    friend class MetalBackend;
 
     void initializeCoefficientMatrix();
+    void markRowDirty(int i);
+    void conductorsChanged();
 
-    MTL::Device *device;
+    std::vector<std::vector<RowSpan>> electricRowSpans;
+    std::vector<std::vector<RowSpan>> magneticRowSpans;
+    std::vector<int> dirtyRows;
+    std::vector<char> rowIsDirty;
 
-    MTL::Buffer *bufferH_x;
-    MTL::Buffer *bufferH_y;
-
-    MTL::Buffer *bufferC_hxh;
-    MTL::Buffer *bufferC_hxe;
-    MTL::Buffer *bufferC_hyh;
-    MTL::Buffer *bufferC_hye;
-    MTL::Buffer *bufferC_eze;
-    MTL::Buffer *bufferC_ezh;
-    MTL::Buffer *bufferM;
-    MTL::Buffer *bufferN;
-
-    MTL::Buffer *bufferConductorField;
-
-    MTL::Library *library;
-    NS::Error *error;
-    MTL::Function *eFieldFunction;
-    MTL::Function *hxFieldFunction;
-    MTL::Function *hyFieldFunction;
+    std::unique_ptr<BasicCpml<Storage, Compute>> cpml;
+    std::unique_ptr<BasicTfsf<Storage, Compute>> tfsf;
+    std::unique_ptr<Backend> currentBackend;
 };
 
+using Simulation = BasicSimulation<float>;
+using SimulationF64 = BasicSimulation<double>;
+using SimulationF16 = BasicSimulation<Half, float>;
+using SimulationBF16 = BasicSimulation<BFloat16, float>;
+
 #endif
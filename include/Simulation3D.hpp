@@ -0,0 +1,141 @@
+#ifndef SIMULATION3D_HPP
+#define SIMULATION3D_HPP
+
+// 3D FDTD solver on a Yee grid: all six field components on L x M x N
+// cells of edge deltaX, x along the planes (index i), y along the rows
+// (j) and z along the columns (k). It shares the 2D solver's building
+// blocks: fields are Linear3DVectors laid out like Linear2DVector,
+// materials are a byte per cell indexing a MaterialCoefficients table
+// whose rows are cut into RowSpans, every row is updated by the
+// KernelTable's curlRow kernels, and a ThreadPool runs the updates.
+//
+// Each half-step sweeps the grid in cache blocks: a block of rows is
+// carried through every plane of a slab in turn, so the H (or E) rows of
+// the previous plane, which the update of the current one reads, are
+// still in cache. By default the planes are cut into one fixed slab per
+// worker that the worker also cleared, so with pinned workers every slab
+// stays in its own worker's memory (slab decomposition). Without it, the
+// blocks of all slabs are handed to whichever worker is free.
+//
+// The grid edges are PEC: E is only updated in the interior, and the H
+// components on the far faces read the zero halo. The hard Ricker source
+// drives E_z at one cell. Only the CPU is supported, and the 2D solver's
+// boundaries, sources, monitors and file formats are not wired up for it.
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Kernels.hpp"
+#include "Linear3DVector.hpp"
+#include "Material.hpp"
+#include "Precision.hpp"
+#include "ThreadPool.hpp"
+
+// Cells [i0, i1) x [j0, j1) x [k0, k1).
+struct GridBox {
+    int i0, j0, k0;
+    int i1, j1, k1;
+
+    bool empty() const { return i0 >= i1 || j0 >= j1 || k0 >= k1; }
+};
+
+template <typename Storage, typename Compute = typename DefaultCompute<Storage>::type>
+class BasicSimulation3D {
+public:
+    using storage_type = Storage;
+    using compute_type = Compute;
+    using Kernels = KernelTable<Storage, Compute>;
+
+    // threads and firstCpu as for ThreadPool. The fields are cleared by
+    // the workers, see Linear3DVector.
+    BasicSimulation3D(int l, int m, int n, Compute deltaX, Compute deltaT, int threads = 0, int firstCpu = -1);
+
+    BasicSimulation3D(const BasicSimulation3D&) = delete;
+    BasicSimulation3D& operator=(const BasicSimulation3D&) = delete;
+
+    Compute deltaX, deltaT;
+    int L, M, N;
+
+    // Cell whose E_z the hard Ricker source drives, the centre by
+    // default. A negative plane turns the source off.
+    int sourcePlane, sourceRow, sourceColumn;
+
+    Compute imp0{377.0f};
+    Compute Cdtds{Compute(1) / std::sqrt(Compute(3))};
+
+    // Simulated time reached by advance().
+    double time{0.0};
+
+    // Index into materials for every cell; all six components of cell
+    // (i, j, k) use it.
+    Linear3DVector<std::uint8_t> material;
+
+    // Coefficient table, vacuum at index 0. E components use eze and
+    // ezh, H components hxh and hxe.
+    std::vector<MaterialCoefficients<Compute>> materials;
+
+    // All fields are L x M x N with one ghost layer. E on the outer faces
+    // stays zero.
+    Linear3DVector<Storage> E_x, E_y, E_z;
+    Linear3DVector<Storage> H_x, H_y, H_z;
+
+    // Appends a material and returns its index, or -1 once the table
+    // holds kMaxMaterials.
+    int addMaterial(const MaterialProperties &properties);
+    bool setMaterial(int id, const MaterialProperties &properties);
+    // Assigns id to the cells of box, clipped to the grid.
+    void fillMaterial(const GridBox &box, int id);
+
+    // Runs whole time steps: E update, source, H update.
+    void advance(int steps);
+
+    // Value of the hard Ricker source at the given time.
+    Compute rickertSource(Compute time, Compute location) const;
+
+    // Slab decomposition, on by default; see above.
+    void setSlabDecomposition(bool enabled) { slabs = enabled; }
+    // Rows per cache block; <= 0 sizes blocks to fit in L2.
+    void setBlockRows(int rows) { blockRowCount = rows; }
+
+    int threadCount() const { return pool.size(); }
+    const char *isa() const { return kernels->isa; }
+    void setKernels(const Kernels &table) { kernels = &table; }
+
+private:
+    // Planes a block is carried through when slabs are off, so that free
+    // workers get work of a useful size.
+    static constexpr int kPlanesPerChunk = 16;
+
+    // The spans of row (i, j) are spans[i][spanFirst[i][j]] up to
+    // spans[i][spanFirst[i][j + 1]].
+    void refreshSpans();
+    int blockRows() const;
+
+    // Rows [rowBegin, rowEnd) of plane i; E takes the interior of both.
+    void updateElectricRows(int i, int rowBegin, int rowEnd);
+    void updateMagneticRows(int i, int rowBegin, int rowEnd);
+    void updateRow(const CurlRow<Storage, Compute> &row, int i, int j, int columnBegin, int columnEnd,
+        bool electric);
+    // Sets the source cell if it lies in planes [planeBegin, planeEnd)
+    // and rows [rowBegin, rowEnd).
+    void applySource(Compute value, int planeBegin, int planeEnd, int rowBegin, int rowEnd);
+
+    ThreadPool pool;
+    const Kernels *kernels;
+
+    std::vector<std::vector<RowSpan>> spans;
+    std::vector<std::vector<int>> spanFirst;
+    std::vector<char> planeIsDirty;
+    bool spansDirty{true};
+
+    bool slabs{true};
+    int blockRowCount{0};
+};
+
+using Simulation3D = BasicSimulation3D<float>;
+using Simulation3DF64 = BasicSimulation3D<double>;
+using Simulation3DF16 = BasicSimulation3D<Half, float>;
+using Simulation3DBF16 = BasicSimulation3D<BFloat16, float>;
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SIMULATION_RUNNER_HPP
+#define SIMULATION_RUNNER_HPP
+
+// Advances a Simulation on its own thread so the solver is not held back
+// by the display. After every batch of steps the runner copies E_z and
+// the conductor mask into a triple buffer, which a render thread reads
+// without locking. Edits from the UI are queued and applied by the solver
+// thread between batches, so the Simulation is only ever touched there.
+//
+// The batch size adapts so one batch takes about a display frame: frames
+// are published at screen rate while the steps in between run through
+// the tiled path.
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConductorMask.hpp"
+#include "Linear2DVector.hpp"
+#include "Simulation.hpp"
+#include "TripleBuffer.hpp"
+
+struct FieldFrame {
+    FieldFrame(int rows, int cols) : ez(rows, cols), conductor(rows, cols) {}
+
+    Linear2DVector<float> ez;
+    ConductorMask conductor;
+    long step{0};
+    double time{0.0};
+};
+
+// Conductor edit, clipped to the grid: either the cells [i0, i1) x
+// [j0, j1), or a brush of the given radius dragged from (i0, j0) to
+// (i1, j1).
+struct SimulationEdit {
+    enum Kind { AddConductor, RemoveConductor };
+    enum Shape { Rectangle, Stroke };
+
+    Kind kind;
+    int i0, j0, i1, j1;
+    Shape shape{Rectangle};
+    double radius{0.0};
+};
+
+template <typename Storage, typename Compute>
+class BasicSimulationRunner {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    // The runner owns sim from start() until stop().
+    explicit BasicSimulationRunner(Simulation &sim);
+
+    ~BasicSimulationRunner();
+
+    void start();
+    void stop();
+
+    // Stops advancing once Simulation::time reaches endTime; <= 0 runs
+    // until stop().
+    void setEndTime(double endTime) { end.store(endTime); }
+
+    void setPaused(bool paused);
+    bool paused() const { return isPaused.load(); }
+
+    // Called from any thread; applied before the next batch.
+    void post(const SimulationEdit &edit);
+
+    // Render side: newest published frame, and whether it changed since
+    // the last call.
+    bool refresh() { return frames.refresh(); }
+    const FieldFrame &frame() const { return frames.front(); }
+
+    // Steps taken so far and the current rate.
+    long steps() const { return stepCount.load(); }
+    double stepsPerSecond() const { return rate.load(); }
+
+    // Wall time one batch aims for; set before start().
+    void setFrameInterval(double seconds) { frameInterval = seconds; }
+
+private:
+    void loop();
+    void applyEdits();
+    void publish();
+    bool finished() const;
+
+    Simulation &sim;
+    TripleBuffer<FieldFrame> frames;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<SimulationEdit> edits;
+    bool stopping{false};
+
+    std::atomic<bool> isPaused{false};
+    std::atomic<double> end{0.0};
+    std::atomic<long> stepCount{0};
+    std::atomic<double> rate{0.0};
+    double frameInterval{1.0 / 60.0};
+};
+
+using SimulationRunner = BasicSimulationRunner<float, float>;
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef SNAPSHOT_FILE_HPP
+#define SNAPSHOT_FILE_HPP
+
+// Time series of field snapshots in one file, for offline analysis.
+// Each frame stores the selected fields as float32 cut into
+// kSnapshotTile x kSnapshotTile chunks, each compressed on its own: the
+// bytes of the chunk's values are shuffled into planes (every value's
+// lowest byte, then the next, ...) and run-length coded, which collapses
+// quiet parts of the grid to a few bytes and the sign/exponent plane of
+// busy ones to a fraction. A chunk that would not shrink is stored raw.
+//
+// The file is a header followed by frames, appended one after another.
+// A frame starts with its step, time, total size and a table of its
+// chunks' codecs and sizes, so a reader finds every frame by hopping
+// from header to header and then decompresses only the chunks a window
+// touches. A run that dies leaves every frame written before it intact.
+// Values are stored in host byte order.
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConductorMask.hpp"
+#include "FieldComponent.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+constexpr int kSnapshotTile = 64;
+
+constexpr unsigned snapshotFieldBit(FieldComponent field) { return 1u << static_cast<int>(field); }
+
+// Appends frames from a background thread. capture() converts the
+// fields into one of two frame buffers on the caller's thread, which is
+// the only work the solver waits for, and hands it to the writer, which
+// compresses and writes it while the next one is captured into the
+// other buffer.
+//
+// That one copy cannot be avoided: the solver updates its fields in
+// place, so the writer could only read them directly if the solver
+// stopped until the frame was compressed, or kept a second set of
+// fields to swap with. The copy is a single streaming pass, which also
+// converts 16-bit and double storage to float32, and is far cheaper than
+// either.
+class SnapshotWriter {
+public:
+    SnapshotWriter() = default;
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Starts a file for an m x n grid holding the fields in the bit set
+    // fields (see snapshotFieldBit()). With append set an existing file of
+    // the same shape is continued instead, after dropping any frames past
+    // step keepUntil and any torn last frame, as a restarted run needs.
+    bool open(const std::string &path, int m, int n, unsigned fields, std::string &error, bool append = false,
+        long keepUntil = 0);
+
+    template <typename Storage, typename Compute>
+    void capture(BasicSimulation<Storage, Compute> &sim, long step);
+
+    // Writes out the frame in flight and closes the file. Returns false,
+    // with error set, if any write failed.
+    bool close(std::string &error);
+
+    bool isOpen() const { return fd >= 0; }
+
+private:
+    struct Frame {
+        long step{0};
+        double time{0.0};
+        std::vector<float> values[kFieldComponentCount];
+    };
+
+    void run();
+    void writeFrame(const Frame &frame);
+
+    int fd{-1};
+    int M{0}, N{0};
+    unsigned fields{0};
+    // Where the next frame goes; the writer thread owns it after open().
+    std::uint64_t writeOffset{0};
+
+    Frame frames[2];
+    int back{0};
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const Frame *job{nullptr};
+    bool stopping{false};
+    std::string firstError;
+
+    // Scratch of the writer thread.
+    std::vector<std::uint8_t> shuffled;
+    std::vector<std::uint8_t> packed;
+};
+
+// Random access to a file written by SnapshotWriter.
+class SnapshotReader {
+public:
+    SnapshotReader() = default;
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    // Reads the header and indexes the frames. A torn last frame is
+    // ignored.
+    bool open(const std::string &path, std::string &error);
+
+    int rows() const { return M; }
+    int columns() const { return N; }
+    bool hasField(FieldComponent field) const { return (fields & snapshotFieldBit(field)) != 0; }
+
+    int frameCount() const { return static_cast<int>(frames.size()); }
+    long frameStep(int frame) const { return frames[frame].step; }
+    double frameTime(int frame) const { return frames[frame].time; }
+
+    // Copies cells window of field in the given frame to out, row i of the
+    // window at out + i * outPitch. Only the chunks it overlaps are read.
+    bool readWindow(int frame, FieldComponent field, const MaskRect &window, float *out, int outPitch,
+        std::string &error);
+
+private:
+    struct FrameEntry {
+        long step;
+        double time;
+        std::uint64_t offset;
+    };
+
+    int fd{-1};
+    int M{0}, N{0};
+    unsigned fields{0};
+    std::vector<FrameEntry> frames;
+    std::vector<std::uint8_t> packed;
+    std::vector<std::uint8_t> shuffled;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef SOURCES_HPP
+#define SOURCES_HPP
+
+// Registry of E_z sources: points, lines and areas of cells driven by a
+// waveform, either hard (the cell is set to the value) or soft (the value
+// is added after the update). Each source scales and delays one of the
+// registered waveforms, so a phased array is one waveform and a source
+// per emitter.
+//
+// Waveforms are never evaluated in the update. prepare() tabulates every
+// source's value for the steps of one advance() call, and the backend
+// applies the cells of the rows it has just updated in one pass over a
+// list sorted by row, which costs a load and a store per cell.
+//
+// The Simulation's built-in hard Ricker source at (sourceRow,
+// sourceColumn) is applied through the same table.
+
+#include <string>
+#include <vector>
+
+#include "ConductorMask.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+struct SourceWaveform {
+    enum class Shape {
+        Ricker,         // (1 - 2 a^2) exp(-a^2), a = pi frequency (t - delay)
+        Gaussian,       // exp(-((t - delay) / width)^2)
+        ModulatedSine,  // sin(2 pi frequency (t - delay)) times the Gaussian
+        Sine,           // sin(2 pi frequency (t - delay)), ramped up over width
+        Sampled,        // samples[k] at delay + k * interval, linear in between
+    };
+
+    Shape shape{Shape::Ricker};
+    double amplitude{1.0};
+    double frequency{1.0};
+    double delay{0.0};
+    double width{1.0};
+    std::vector<double> samples;
+    double interval{1.0};
+};
+
+// Parses "ricker", "gaussian", "modulated_sine", "sine" or "sampled".
+bool parseWaveformShape(const std::string &name, SourceWaveform::Shape &shape);
+
+double waveformValue(const SourceWaveform &waveform, double time);
+
+// Reads one sample per line; '#' starts a comment.
+bool loadWaveformSamples(const std::string &path, std::vector<double> &samples, std::string &error);
+
+enum class SourceMode { Hard, Soft };
+
+template <typename Storage, typename Compute>
+class BasicSourceSet {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    explicit BasicSourceSet(Simulation &sim) : sim(sim) {}
+
+    BasicSourceSet(const BasicSourceSet&) = delete;
+    BasicSourceSet& operator=(const BasicSourceSet&) = delete;
+
+    int addWaveform(const SourceWaveform &waveform);
+    int waveformCount() const { return static_cast<int>(waveforms.size()); }
+
+    // Register a source of an added waveform, scaled by amplitude and
+    // delayed by delay, and return its index, or -1 if the waveform is
+    // unknown or a cell lies outside [1, M-1) x [1, N-1): the outer ring
+    // of E_z is the PEC edge, which the solver never updates. A line
+    // covers one cell per step along its longer axis; an area covers the
+    // cells of rect.
+    int addPoint(int waveform, int i, int j, SourceMode mode, double amplitude = 1.0, double delay = 0.0);
+    int addLine(int waveform, int i0, int j0, int i1, int j1, SourceMode mode, double amplitude = 1.0,
+        double delay = 0.0);
+    int addArea(int waveform, const MaskRect &rect, SourceMode mode, double amplitude = 1.0, double delay = 0.0);
+
+    // Removes the sources and waveforms; the built-in source stays.
+    void clear();
+
+    int sourceCount() const { return static_cast<int>(sources.size()); }
+
+    // Cells driven in the last prepare(), the built-in source included.
+    int cellCount() const { return static_cast<int>(cells.size()); }
+    int cellRow(int k) const { return cells[k].i; }
+    int cellColumn(int k) const { return cells[k].j; }
+
+    // Called by Simulation::advance() before the backend: tabulates up to
+    // steps steps starting at startTime and returns how many the backend
+    // may take.
+    int prepare(int steps, double startTime);
+
+    // Called by backends right after the E_z update of rows [rowBegin,
+    // rowEnd), within [1, M-1), for the level-th step since prepare().
+    void applyElectricRows(int level, int rowBegin, int rowEnd);
+    // The same for every updated row, writing through a backend's pointer
+    // with E_z's pitch.
+    void applyElectricField(int level, Storage *ez);
+
+private:
+    // Steps one prepare() covers, which bounds the table.
+    static constexpr int kMaxLevels = 1024;
+
+    struct Source {
+        int waveform;
+        double amplitude, delay;
+    };
+
+    struct Cell {
+        int i, j;
+        int source;  // column of the table; sourceCount() is the built-in one
+        bool hard;
+    };
+
+    // Appends a source without cells, or returns -1.
+    int newSource(int waveform, double amplitude, double delay);
+    void rebuild();
+    void apply(int level, Storage *ez, int rowBegin, int rowEnd);
+
+    Simulation &sim;
+
+    std::vector<SourceWaveform> waveforms;
+    std::vector<Source> sources;
+    std::vector<Cell> registered;  // in registration order
+
+    // Cells sorted by row and column; row i's are rowFirst[i] up to
+    // rowFirst[i+1].
+    std::vector<Cell> cells;
+    std::vector<int> rowFirst;
+    bool stale{true};
+    int builtInRow{-1}, builtInColumn{-1};
+
+    // Level-major, one column per source and the built-in one last.
+    std::vector<Compute> table;
+};
+
+#endif
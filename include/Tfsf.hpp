@@ -0,0 +1,96 @@
+#ifndef TFSF_HPP
+#define TFSF_HPP
+
+// Total-field/scattered-field plane wave. Inside a rectangle the grid
+// holds the total field, outside it only the scattered field; the plane
+// wave enters through corrections to the cells on either side of the
+// rectangle's edges, which add or remove the incident field where the
+// update reaches across an edge. A scatterer inside the rectangle sees a
+// clean plane wave and only its scattered field leaves.
+//
+// The incident field comes from a 1D auxiliary grid along the direction
+// of travel, driven by the Ricker wavelet at one end and terminated by a
+// graded, matched lossy layer at the other. It uses the 2D update with
+// the 2D Courant number, so its dispersion matches the 2D grid for waves
+// along an axis and the rectangle leaks almost nothing. prepare() runs the
+// auxiliary grid ahead for the steps of one advance() and keeps the
+// incident values each step needs, so bands of a tiled update can apply
+// their corrections at their own pace.
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "ConductorMask.hpp"
+#include "Linear2DVector.hpp"
+#include "Precision.hpp"
+
+template <typename Storage, typename Compute>
+class BasicSimulation;
+
+// Direction of travel along one grid axis.
+enum class TfsfDirection { PlusI, MinusI, PlusJ, MinusJ };
+
+// Parses "+i", "-i", "+j" or "-j".
+bool parseTfsfDirection(const std::string &name, TfsfDirection &direction);
+
+struct TfsfParameters {
+    // Total-field cells, half-open.
+    MaskRect region{};
+    TfsfDirection direction{TfsfDirection::PlusI};
+};
+
+template <typename Storage, typename Compute>
+class BasicTfsf {
+public:
+    using Simulation = BasicSimulation<Storage, Compute>;
+
+    BasicTfsf(Simulation &sim, const TfsfParameters &parameters);
+
+    const TfsfParameters &parameters() const { return params; }
+
+    // Runs the auxiliary grid through up to steps steps starting at
+    // startTime and returns how many the backend may take.
+    int prepare(int steps, double startTime);
+
+    // Adds the incident field to rows [rowBegin, rowEnd) for the
+    // level-th step since prepare(), right after the interior update of
+    // those rows. Rows are independent, so the range may be split
+    // between threads.
+    void correctElectricRows(int level, int rowBegin, int rowEnd);
+    void correctMagneticRows(int level, int rowBegin, int rowEnd);
+
+    // True if region leaves a cell of scattered field, and the absorbing
+    // layer, between itself and the edges of an m x n grid.
+    static bool fits(int m, int n, int cpmlThickness, const MaskRect &region);
+
+    // The auxiliary grid, which checkpoints save along with the grid.
+    std::array<std::vector<Compute>*, 2> state() { return {&auxE, &auxH}; }
+
+private:
+    // Steps one prepare() covers, which bounds the incident tables.
+    static constexpr int kMaxLevels = 256;
+    static constexpr int kLossCells = 40;
+
+    bool alongRows() const { return params.direction == TfsfDirection::PlusI || params.direction == TfsfDirection::MinusI; }
+    bool forward() const { return params.direction == TfsfDirection::PlusI || params.direction == TfsfDirection::PlusJ; }
+    // Incident E_z at coordinate x along the axis, and the incident H
+    // half a cell further on (H_y along rows, -H_x along columns).
+    Compute incidentE(int level, int x) const;
+    Compute incidentH(int level, int x) const;
+
+    Simulation &sim;
+    TfsfParameters params;
+
+    // Auxiliary cell p sits at axis coordinate origin + p going forward,
+    // origin - p going backward; auxH[p] lies half a cell past auxE[p].
+    int origin;
+    int span;  // cells whose incident field the corrections read
+    std::vector<Compute> auxE, auxH;
+    std::vector<Compute> ce, ch, hh, he;
+
+    // span values per level: E after the level's update, H before it.
+    std::vector<Compute> incidentEs, incidentHs;
+};
+
+#endif
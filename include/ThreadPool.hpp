@@ -0,0 +1,72 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+// Fixed set of worker threads that live as long as the pool. Work is
+// handed out with run(), which executes a task once per worker (the
+// calling thread acts as worker 0) and returns when all of them are done.
+// The solver and the renderer each keep one; calls to run() from
+// different threads on the same pool are serialised.
+
+#include <atomic>
+#include <barrier>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threads <= 0 uses one worker per hardware thread. With firstCpu >= 0
+    // worker w is pinned to CPU firstCpu + w (modulo the CPU count) where
+    // the platform allows it; worker 0 is the caller and is left alone.
+    explicit ThreadPool(int threads = 0, int firstCpu = -1);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return numThreads; }
+
+    // Calls task(worker) on every worker, worker in [0, size()).
+    void run(const std::function<void(int)> &task);
+
+    // Splits [begin, end) into size() contiguous chunks and calls
+    // body(chunkBegin, chunkEnd) for each non-empty one.
+    void parallelFor(int begin, int end, const std::function<void(int, int)> &body);
+
+    // Hands [begin, end) out in chunks of grain to whichever worker is
+    // free, for work whose cost varies between chunks.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+    // Only valid inside run(): waits until every worker has reached it.
+    void barrier() { sync.arrive_and_wait(); }
+
+    // Chunk of [begin, end) assigned to worker out of count workers.
+    static void partition(int begin, int end, int worker, int count, int &chunkBegin, int &chunkEnd);
+
+    // Smallest multiple of minimumRows after which rows of rowBytes each
+    // end on a cache line, so chunks of that many rows never share one.
+    static int cacheAlignedRows(int rowBytes, int minimumRows = 1);
+
+private:
+    void workerLoop(int worker);
+
+    int numThreads;
+    std::vector<std::thread> workers;
+
+    std::mutex submit;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)> *task{nullptr};
+    std::uint64_t generation{0};
+    int pending{0};
+    bool stopping{false};
+
+    std::barrier<> sync;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+// Single-producer, single-consumer triple buffer. The producer fills
+// back() and publishes it; the consumer picks up the newest published
+// slot with refresh() and reads front(). Neither side ever blocks or
+// waits for the other, and frames the consumer was too slow to see are
+// simply overwritten.
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer(const T &initial) : slots{initial, initial, initial} {}
+
+    // Producer side.
+    T &back() { return slots[backIndex]; }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Consumer side. Returns true if front() now holds a newer frame.
+    bool refresh() {
+        if (!(middle.load(std::memory_order_relaxed) & kFresh)) {
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T &front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kFresh = 4;
+
+    T slots[3];
+    int backIndex{0};
+    int frontIndex{1};
+    // Slot between the two sides, with kFresh set when it holds a frame
+    // the consumer has not seen yet.
+    std::atomic<int> middle{2};
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include "ActivityMap.hpp"
+
+
+ActivityMap::ActivityMap(int rows, int cols)
+    : rows_(rows), cols_(cols),
+      tileRows_((rows + kTileSize - 1) / kTileSize), tileCols_((cols + kTileSize - 1) / kTileSize),
+      tiles(static_cast<std::size_t>(tileRows_) * tileCols_, 0), rowRuns(tileRows_) {
+    fill();
+}
+
+void ActivityMap::markCells(int i0, int j0, int i1, int j1) {
+    i0 = std::max(i0, 0);
+    j0 = std::max(j0, 0);
+    i1 = std::min(i1, rows_);
+    j1 = std::min(j1, cols_);
+    for (int ti = i0 / kTileSize; ti * kTileSize < i1; ti++) {
+        for (int tj = j0 / kTileSize; tj * kTileSize < j1; tj++) {
+            mark(ti, tj);
+        }
+    }
+}
+
+void ActivityMap::clear() {
+    std::fill(tiles.begin(), tiles.end(), 0);
+    rebuildRuns();
+}
+
+void ActivityMap::fill() {
+    std::fill(tiles.begin(), tiles.end(), 1);
+    rebuildRuns();
+}
+
+void ActivityMap::dilate() {
+    scratch.assign(tiles.size(), 0);
+    for (int ti = 0; ti < tileRows_; ti++) {
+        for (int tj = 0; tj < tileCols_; tj++) {
+            if (!active(ti, tj)) {
+                continue;
+            }
+            for (int i = std::max(ti - 1, 0); i <= std::min(ti + 1, tileRows_ - 1); i++) {
+                for (int j = std::max(tj - 1, 0); j <= std::min(tj + 1, tileCols_ - 1); j++) {
+                    scratch[i * tileCols_ + j] = 1;
+                }
+            }
+        }
+    }
+    tiles.swap(scratch);
+    rebuildRuns();
+}
+
+double ActivityMap::fraction() const {
+    return tiles.empty() ? 0.0 : static_cast<double>(activeTiles) / tiles.size();
+}
+
+void ActivityMap::rebuildRuns() {
+    activeTiles = 0;
+    for (int ti = 0; ti < tileRows_; ti++) {
+        std::vector<Run> &runs = rowRuns[ti];
+        runs.clear();
+        for (int tj = 0; tj < tileCols_; tj++) {
+            if (!active(ti, tj)) {
+                continue;
+            }
+            activeTiles++;
+            const int begin = tj * kTileSize;
+            const int end = std::min(cols_, begin + kTileSize);
+            if (!runs.empty() && runs.back().end == begin) {
+                runs.back().end = end;
+            } else {
+                runs.push_back({begin, end});
+            }
+        }
+    }
+}
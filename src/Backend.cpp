@@ -0,0 +1,23 @@
+#include "Backend.hpp"
+#include "Simulation.hpp"
+
+
+template <typename S, typename C>
+void BasicBackend<S, C>::advance(int steps) {
+    for (int step = 0; step < steps; step++) {
+        stepElectricField();
+        sim.sources.applyElectricField(step, electricField());
+        stepMagneticField();
+        sim.time += sim.deltaT;
+        if (!sim.probes.empty() || !sim.dft.empty()) {
+            synchronize();
+            sim.probes.sampleElectricRows(step, 0, sim.M);
+            sim.probes.sampleMagneticRows(step, 0, sim.M);
+            sim.dft.accumulateElectricRows(step, 0, sim.M);
+            sim.dft.accumulateMagneticRows(step, 0, sim.M);
+        }
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicBackend<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Checkpoint.hpp"
+#include "FileIO.hpp"
+
+static const char kMagic[8] = {'E', 'M', 'S', 'I', 'M', 'C', 'K', 'P'};
+
+enum SectionId : std::uint32_t {
+    kElectricZ = 1,
+    kMagneticX,
+    kMagneticY,
+    kMaterialIds,
+    kMaterialTable,
+    kConductors,
+    kCpmlPsi,  // index 0-3 in BasicCpml::state() order
+    kDftSums,  // index is the monitor; since version 2
+    kTfsfAux,  // index 0-1 in BasicTfsf::state() order; since version 2
+    kDispersion,  // BasicDispersion::state(); since version 2
+};
+
+// Version 1 files had room for 16 sections; the rest of their header
+// page is zero, so they read fine with the larger table.
+constexpr int kMaxSections = 64;
+
+struct Section {
+    std::uint32_t id, index;
+    std::uint64_t offset, bytes;
+};
+
+// First page of the file.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t sectionCount;
+    char precision[8];
+    std::uint32_t storageBytes, computeBytes;
+    std::int32_t M, N, halo, pitch;
+    std::int32_t sourceRow, sourceColumn;
+    std::int64_t step;
+    double time, deltaX, deltaY, deltaT;
+    std::int32_t materialCount, cpmlThickness;
+    double cpmlGrading, cpmlSigmaScale, cpmlKappaMax, cpmlAlphaMax;
+    Section sections[kMaxSections];
+    std::int64_t dftSteps;
+};
+
+static_assert(sizeof(Header) <= kMappableAlignment, "the header must fit its page");
+
+// One array to write, and where.
+struct Chunk {
+    Section section;
+    const void *data;
+};
+
+static std::uint64_t roundUp(std::uint64_t bytes) {
+    return (bytes + kMappableAlignment - 1) / kMappableAlignment * kMappableAlignment;
+}
+
+// Fills in the header for sim and lists the arrays to write, which
+// still point into sim.
+template <typename S, typename C>
+static bool describe(BasicSimulation<S, C> &sim, long step, Header &header, std::vector<Chunk> &chunks,
+    std::string &error) {
+    header = Header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kCheckpointVersion;
+    std::strncpy(header.precision, precisionName<S>(), sizeof(header.precision) - 1);
+    header.storageBytes = sizeof(S);
+    header.computeBytes = sizeof(C);
+    header.M = sim.M;
+    header.N = sim.N;
+    header.halo = sim.E_z.halo();
+    header.pitch = sim.E_z.pitch();
+    header.sourceRow = sim.sourceRow;
+    header.sourceColumn = sim.sourceColumn;
+    header.step = step;
+    header.time = sim.time;
+    header.deltaX = sim.deltaX;
+    header.deltaY = sim.deltaY;
+    header.deltaT = sim.deltaT;
+    header.materialCount = static_cast<std::int32_t>(sim.materials.size());
+
+    chunks.clear();
+    auto add = [&](SectionId id, std::uint32_t index, const void *data, std::size_t bytes) {
+        chunks.push_back({{id, index, 0, bytes}, data});
+    };
+    add(kElectricZ, 0, sim.E_z.storage(), sim.E_z.storageSize() * sizeof(S));
+    add(kMagneticX, 0, sim.H_x.storage(), sim.H_x.storageSize() * sizeof(S));
+    add(kMagneticY, 0, sim.H_y.storage(), sim.H_y.storageSize() * sizeof(S));
+    add(kMaterialIds, 0, sim.material.storage(), sim.material.storageSize());
+    add(kMaterialTable, 0, sim.materials.data(), sim.materials.size() * sizeof(MaterialCoefficients<C>));
+    add(kConductors, 0, sim.conductors.storage(), sim.conductors.storageSize() * sizeof(ConductorMask::Word));
+
+    if (BasicCpml<S, C> *cpml = sim.absorbingBoundary()) {
+        const CpmlParameters &parameters = cpml->parameters();
+        header.cpmlThickness = parameters.thickness;
+        header.cpmlGrading = parameters.grading;
+        header.cpmlSigmaScale = parameters.sigmaScale;
+        header.cpmlKappaMax = parameters.kappaMax;
+        header.cpmlAlphaMax = parameters.alphaMax;
+        std::uint32_t index = 0;
+        for (Linear2DVector<C> *psi: cpml->state()) {
+            add(kCpmlPsi, index++, psi->storage(), psi->storageSize() * sizeof(C));
+        }
+    }
+    for (int m = 0; m < sim.dft.monitorCount(); m++) {
+        std::vector<C> &sums = sim.dft.sums(m);
+        add(kDftSums, m, sums.data(), sums.size() * sizeof(C));
+    }
+    if (BasicTfsf<S, C> *tfsf = sim.planeWave()) {
+        std::uint32_t index = 0;
+        for (std::vector<C> *aux: tfsf->state()) {
+            add(kTfsfAux, index++, aux->data(), aux->size() * sizeof(C));
+        }
+    }
+    if (!sim.dispersion.state().empty()) {
+        std::vector<C> &polarization = sim.dispersion.state();
+        add(kDispersion, 0, polarization.data(), polarization.size() * sizeof(C));
+    }
+    if (chunks.size() > kMaxSections) {
+        error = "too many DFT monitors to checkpoint";
+        return false;
+    }
+    header.dftSteps = sim.dft.steps();
+
+    std::uint64_t offset = kMappableAlignment;
+    for (Chunk &chunk: chunks) {
+        chunk.section.offset = offset;
+        offset += roundUp(chunk.section.bytes);
+        header.sections[header.sectionCount++] = chunk.section;
+    }
+    return true;
+}
+
+static bool writeFile(const std::string &path, const Header &header, const std::vector<Chunk> &chunks,
+    std::string &error) {
+    const std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "cannot create " + temporary;
+        return false;
+    }
+
+    bool ok = writeAll(fd, &header, sizeof(header), 0);
+    std::uint64_t end = kMappableAlignment;
+    for (const Chunk &chunk: chunks) {
+        ok = ok && writeAll(fd, chunk.data, chunk.section.bytes, chunk.section.offset);
+        end = chunk.section.offset + roundUp(chunk.section.bytes);
+    }
+    // Pad the last section to a whole page so it can be mapped too.
+    ok = ok && ::ftruncate(fd, static_cast<off_t>(end)) == 0;
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+static bool readHeader(int fd, const std::string &path, Header &header, std::string &error) {
+    if (!readAll(fd, &header, sizeof(header), 0) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        error = path + " is not a checkpoint";
+        return false;
+    }
+    if (header.version < 1 || header.version > kCheckpointVersion) {
+        error = path + ": unsupported checkpoint version " + std::to_string(header.version);
+        return false;
+    }
+    if (header.sectionCount > kMaxSections) {
+        error = path + ": corrupt section table";
+        return false;
+    }
+    header.precision[sizeof(header.precision) - 1] = '\0';
+    return true;
+}
+
+static const Section *findSection(const Header &header, SectionId id, std::uint32_t index) {
+    for (std::uint32_t k = 0; k < header.sectionCount; k++) {
+        if (header.sections[k].id == id && header.sections[k].index == index) {
+            return &header.sections[k];
+        }
+    }
+    return nullptr;
+}
+
+// Fills bytes at destination from a section. With map set, and when the
+// page size allows it, the file is mapped privately over destination
+// instead of read, which replaces the pages without touching them.
+static bool restore(int fd, const Section *section, void *destination, std::uint64_t bytes, bool map) {
+    if (!section || section->bytes != bytes) {
+        return false;
+    }
+    static const long page = ::sysconf(_SC_PAGESIZE);
+    if (map && page > 0 && kMappableAlignment % page == 0 &&
+        reinterpret_cast<std::uintptr_t>(destination) % page == 0 && section->offset % page == 0) {
+        // Only whole pages of the storage are replaced; it owns them all.
+        const std::uint64_t length = (bytes + page - 1) / page * page;
+        void *mapped = ::mmap(destination, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+            static_cast<off_t>(section->offset));
+        if (mapped == destination) {
+            return true;
+        }
+    }
+    return readAll(fd, destination, bytes, section->offset);
+}
+
+bool readCheckpointInfo(const std::string &path, CheckpointInfo &info, std::string &error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    Header header;
+    const bool ok = readHeader(fd, path, header, error);
+    ::close(fd);
+    if (ok) {
+        info = {header.version, header.precision, header.M, header.N, static_cast<long>(header.step), header.time,
+            header.cpmlThickness};
+    }
+    return ok;
+}
+
+template <typename S, typename C>
+bool saveCheckpoint(BasicSimulation<S, C> &sim, const std::string &path, long step, std::string &error) {
+    sim.synchronize();
+    Header header;
+    std::vector<Chunk> chunks;
+    return describe(sim, step, header, chunks, error) && writeFile(path, header, chunks, error);
+}
+
+template <typename S, typename C>
+bool loadCheckpoint(BasicSimulation<S, C> &sim, const std::string &path, long &step, std::string &error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    // The mappings keep the file alive, so it can be closed on every path.
+    std::unique_ptr<int, void (*)(int*)> closer(&fd, [](int *f) { ::close(*f); });
+
+    Header header;
+    if (!readHeader(fd, path, header, error)) {
+        return false;
+    }
+    if (std::string(header.precision) != precisionName<S>() || header.storageBytes != sizeof(S) ||
+        header.computeBytes != sizeof(C)) {
+        error = path + " holds a " + header.precision + " run";
+        return false;
+    }
+    if (header.M != sim.M || header.N != sim.N || header.halo != sim.E_z.halo() || header.pitch != sim.E_z.pitch()) {
+        error = path + " holds a " + std::to_string(header.M) + "x" + std::to_string(header.N) +
+            " grid with a different layout";
+        return false;
+    }
+    if (header.deltaX != double(sim.deltaX) || header.deltaY != double(sim.deltaY) ||
+        header.deltaT != double(sim.deltaT)) {
+        error = path + " was taken with a different spacing or time step";
+        return false;
+    }
+    if (header.materialCount < 1 || header.materialCount > kMaxMaterials) {
+        error = path + ": corrupt material table";
+        return false;
+    }
+
+    CpmlParameters parameters;
+    parameters.thickness = header.cpmlThickness;
+    parameters.grading = header.cpmlGrading;
+    parameters.sigmaScale = header.cpmlSigmaScale;
+    parameters.kappaMax = header.cpmlKappaMax;
+    parameters.alphaMax = header.cpmlAlphaMax;
+    if (!sim.setAbsorbingBoundary(parameters)) {
+        error = path + ": absorbing boundary does not fit";
+        return false;
+    }
+
+    sim.synchronize();
+    sim.materials.resize(header.materialCount);
+    bool ok = restore(fd, findSection(header, kElectricZ, 0), sim.E_z.storage(), sim.E_z.storageSize() * sizeof(S), true) &&
+        restore(fd, findSection(header, kMagneticX, 0), sim.H_x.storage(), sim.H_x.storageSize() * sizeof(S), true) &&
+        restore(fd, findSection(header, kMagneticY, 0), sim.H_y.storage(), sim.H_y.storageSize() * sizeof(S), true) &&
+        restore(fd, findSection(header, kMaterialIds, 0), sim.material.storage(), sim.material.storageSize(), true) &&
+        restore(fd, findSection(header, kMaterialTable, 0), sim.materials.data(),
+            sim.materials.size() * sizeof(MaterialCoefficients<C>), false) &&
+        restore(fd, findSection(header, kConductors, 0), sim.conductors.storage(),
+            sim.conductors.storageSize() * sizeof(ConductorMask::Word), false);
+    // The kernels index the table with every id, so ids it does not hold
+    // are rejected like a mismatched grid.
+    for (int i = 0; ok && i < sim.M; i++) {
+        const std::uint8_t *row = sim.material.row(i);
+        if (*std::max_element(row, row + sim.N) >= header.materialCount) {
+            error = path + ": material ids outside the material table";
+            return false;
+        }
+    }
+    if (BasicCpml<S, C> *cpml = sim.absorbingBoundary()) {
+        std::uint32_t index = 0;
+        for (Linear2DVector<C> *psi: cpml->state()) {
+            ok = ok && restore(fd, findSection(header, kCpmlPsi, index++), psi->storage(),
+                psi->storageSize() * sizeof(C), true);
+        }
+    }
+    // A plane wave set up for the restart picks up where the saved one
+    // was, if the checkpoint had one of the same size.
+    if (BasicTfsf<S, C> *tfsf = sim.planeWave()) {
+        std::uint32_t index = 0;
+        for (std::vector<C> *aux: tfsf->state()) {
+            if (const Section *section = findSection(header, kTfsfAux, index++)) {
+                ok = ok && restore(fd, section, aux->data(), aux->size() * sizeof(C), false);
+            }
+        }
+    }
+    // The polarization is laid out by the restored material ids; a run
+    // saved without it starts from zero.
+    sim.dispersion.materialsChanged();
+    sim.dispersion.refresh();
+    std::vector<C> &polarization = sim.dispersion.state();
+    std::fill(polarization.begin(), polarization.end(), C(0));
+    if (const Section *section = findSection(header, kDispersion, 0)) {
+        ok = ok && restore(fd, section, polarization.data(), polarization.size() * sizeof(C), false);
+    }
+    // Monitors the checkpoint has no sums for start from zero.
+    sim.dft.reset();
+    for (int m = 0; m < sim.dft.monitorCount(); m++) {
+        if (const Section *section = findSection(header, kDftSums, m)) {
+            std::vector<C> &sums = sim.dft.sums(m);
+            ok = ok && restore(fd, section, sums.data(), sums.size() * sizeof(C), false);
+            sim.dft.setSteps(header.dftSteps);
+        }
+    }
+
+    sim.time = header.time;
+    sim.sourceRow = header.sourceRow;
+    sim.sourceColumn = header.sourceColumn;
+    sim.stateChanged();
+    if (!ok) {
+        error = path + " is truncated or does not match this build";
+        return false;
+    }
+    step = static_cast<long>(header.step);
+    return true;
+}
+
+// Private copy of every array, so the solver can move on while it is
+// written.
+template <typename S, typename C>
+struct BasicCheckpointWriter<S, C>::Image {
+    Header header;
+    std::vector<Chunk> chunks;
+    std::vector<std::unique_ptr<char[]>> copies;
+};
+
+template <typename S, typename C>
+BasicCheckpointWriter<S, C>::~BasicCheckpointWriter() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+template <typename S, typename C>
+void BasicCheckpointWriter<S, C>::save(Simulation &sim, const std::string &path, long step) {
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    sim.synchronize();
+    auto image = std::make_shared<Image>();
+    std::string error;
+    if (!describe(sim, step, image->header, image->chunks, error)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (firstError.empty()) {
+            firstError = error;
+        }
+        return;
+    }
+    for (Chunk &chunk: image->chunks) {
+        image->copies.emplace_back(new char[chunk.section.bytes]);
+        std::memcpy(image->copies.back().get(), chunk.data, chunk.section.bytes);
+        chunk.data = image->copies.back().get();
+    }
+
+    worker = std::thread([this, image, path] {
+        std::string error;
+        if (!writeFile(path, image->header, image->chunks, error)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (firstError.empty()) {
+                firstError = error;
+            }
+        }
+    });
+}
+
+template <typename S, typename C>
+bool BasicCheckpointWriter<S, C>::wait(std::string &error) {
+    if (worker.joinable()) {
+        worker.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!firstError.empty()) {
+        error = firstError;
+        return false;
+    }
+    return true;
+}
+
+#define EMSIM_INSTANTIATE(S, C)                                                                         \
+    template bool saveCheckpoint<S, C>(BasicSimulation<S, C>&, const std::string&, long, std::string&); \
+    template bool loadCheckpoint<S, C>(BasicSimulation<S, C>&, const std::string&, long&, std::string&); \
+    template class BasicCheckpointWriter<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+
+#include "Colormap.hpp"
+
+
+struct Rgb {
+    double r, g, b;
+};
+
+static std::uint8_t toByte(double value) {
+    return static_cast<std::uint8_t>(std::clamp(value, 0.0, 255.0));
+}
+
+template <typename Function>
+static std::vector<std::uint32_t> sample(Function colorAt) {
+    std::vector<std::uint32_t> table(Colormap::kEntries);
+    for (int k = 0; k < Colormap::kEntries; k++) {
+        Rgb c = colorAt(k / double(Colormap::kEntries - 1));
+        table[k] = packRgba(toByte(c.r), toByte(c.g), toByte(c.b));
+    }
+    return table;
+}
+
+// Piecewise linear through evenly spaced control points.
+template <size_t Count>
+static Rgb interpolate(const std::array<Rgb, Count> &points, double t) {
+    double x = t * (Count - 1);
+    size_t k = std::min(static_cast<size_t>(x), Count - 2);
+    double f = x - k;
+    const Rgb &a = points[k];
+    const Rgb &b = points[k + 1];
+    return {a.r + f * (b.r - a.r), a.g + f * (b.g - a.g), a.b + f * (b.b - a.b)};
+}
+
+// Red for positive, blue for negative, brightness sqrt(|value|).
+static Rgb redBlue(double t) {
+    double value = 2.0 * t - 1.0;
+    double fraction = std::sqrt(std::abs(value)) * 255;
+    return value > 0 ? Rgb{fraction, 0, 0} : Rgb{0, 0, fraction};
+}
+
+static Rgb grayScale(double t) {
+    double gray = (t - 0.5) * 255 + 127;
+    return {gray, gray, gray};
+}
+
+static Rgb coolWarm(double t) {
+    static const std::array<Rgb, 5> points = {{
+        {59, 76, 192}, {141, 176, 254}, {221, 221, 221}, {244, 154, 123}, {180, 4, 38}}};
+    return interpolate(points, t);
+}
+
+static Rgb viridis(double t) {
+    static const std::array<Rgb, 9> points = {{
+        {68, 1, 84}, {71, 45, 123}, {59, 82, 139}, {44, 114, 142}, {33, 145, 140},
+        {40, 174, 128}, {94, 201, 98}, {173, 220, 48}, {253, 231, 37}}};
+    return interpolate(points, t);
+}
+
+const std::vector<const Colormap*> &Colormap::all() {
+    static const Colormap maps[] = {
+        Colormap("redblue", sample(redBlue)),
+        Colormap("grayscale", sample(grayScale)),
+        Colormap("coolwarm", sample(coolWarm)),
+        Colormap("viridis", sample(viridis)),
+    };
+    static const std::vector<const Colormap*> list = {&maps[0], &maps[1], &maps[2], &maps[3]};
+    return list;
+}
+
+const Colormap *Colormap::find(const std::string &name) {
+    for (const Colormap *map: all()) {
+        if (map->name() == name) {
+            return map;
+        }
+    }
+    return nullptr;
+}
+
+
+ColorRange fieldRange(const float *field, int pitch, int rowBegin, int rowEnd, int cols, bool symmetric) {
+    float low = 0.0f, high = 0.0f;
+    for (int i = rowBegin; i < rowEnd; i++) {
+        const float *values = field + static_cast<size_t>(i) * pitch;
+        for (int j = 0; j < cols; j++) {
+            low = std::min(low, values[j]);
+            high = std::max(high, values[j]);
+        }
+    }
+    if (symmetric) {
+        high = std::max(-low, high);
+        low = -high;
+    }
+    return {low, high};
+}
+
+
+FieldColorizer::FieldColorizer(const Colormap &colormap) : map(&colormap), kernels(selectColorizer()) {}
+
+ColorRange FieldColorizer::frameRange(const float *field, int pitch, int rows, int cols) const {
+    if (rangeMode == RangeMode::Fixed) {
+        return fixedRange;
+    }
+    return fieldRange(field, pitch, 0, rows, cols, rangeMode == RangeMode::Symmetric);
+}
+
+void FieldColorizer::colorizeRows(const float *field, int pitch, const ConductorMask *conductor,
+    std::uint32_t *out, int outPitch, int rowBegin, int rowEnd, int cols, ColorRange range) const {
+    const float span = range.high - range.low;
+    const float scale = span > 0.0f ? (Colormap::kEntries - 1) / span : 0.0f;
+    // +0.5 rounds to the nearest entry, as the kernels truncate
+    ColorizeParams params = {map->table(), scale, 0.5f - range.low * scale,
+        float(Colormap::kEntries - 1), conductorColor};
+    if (span <= 0.0f) {
+        params.offset = Colormap::kEntries / 2;
+    }
+
+    for (int i = rowBegin; i < rowEnd; i++) {
+        kernels.colorizeRow(field + static_cast<size_t>(i) * pitch,
+            conductor ? conductor->row(i) : nullptr,
+            out + static_cast<size_t>(i) * outPitch, cols, params);
+    }
+}
+
+
+bool writeImage(const std::string &path, const std::uint32_t *pixels, int width, int height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<char> row(static_cast<size_t>(width) * 3);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            std::uint32_t p = pixels[static_cast<size_t>(i) * width + j];
+            row[3*j + 0] = static_cast<char>(p & 0xFF);
+            row[3*j + 1] = static_cast<char>((p >> 8) & 0xFF);
+            row[3*j + 2] = static_cast<char>((p >> 16) & 0xFF);
+        }
+        file.write(row.data(), row.size());
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "ConductorMask.hpp"
+
+
+MaskRect MaskRect::merged(const MaskRect &other) const {
+    if (empty()) {
+        return other;
+    }
+    if (other.empty()) {
+        return *this;
+    }
+    return {std::min(i0, other.i0), std::min(j0, other.j0), std::max(i1, other.i1), std::max(j1, other.j1)};
+}
+
+
+ConductorMask::ConductorMask(int rows, int cols)
+    : rows_(rows), cols_(cols), pitch_((cols + kWordBits - 1) / kWordBits + 1),
+      words(static_cast<std::size_t>(rows) * pitch_, 0) {}
+
+void ConductorMask::set(int i, int j, bool value) {
+    if (0 <= i && i < rows_ && 0 <= j && j < cols_) {
+        fillSpan(i, j, j + 1, value);
+        markDirty({i, j, i + 1, j + 1});
+    }
+}
+
+void ConductorMask::fillRect(const MaskRect &rect, bool value) {
+    MaskRect clipped = {std::max(rect.i0, 0), std::max(rect.j0, 0), std::min(rect.i1, rows_), std::min(rect.j1, cols_)};
+    if (clipped.empty()) {
+        return;
+    }
+    for (int i = clipped.i0; i < clipped.i1; i++) {
+        fillSpan(i, clipped.j0, clipped.j1, value);
+    }
+    markDirty(clipped);
+}
+
+void ConductorMask::fillPolygon(const std::vector<MaskPoint> &vertices, bool value) {
+    if (vertices.size() < 3) {
+        return;
+    }
+    double low = vertices[0].i, high = vertices[0].i;
+    for (const MaskPoint &p: vertices) {
+        low = std::min(low, p.i);
+        high = std::max(high, p.i);
+    }
+
+    std::vector<double> crossings;
+    const int first = std::max(0, static_cast<int>(std::ceil(low)));
+    const int last = std::min(rows_ - 1, static_cast<int>(std::floor(high)));
+    for (int i = first; i <= last; i++) {
+        // Where the edges cross the line through the centres of row i.
+        crossings.clear();
+        for (std::size_t k = 0; k < vertices.size(); k++) {
+            const MaskPoint &a = vertices[k];
+            const MaskPoint &b = vertices[(k + 1) % vertices.size()];
+            if ((a.i <= i) != (b.i <= i)) {
+                crossings.push_back(a.j + (i - a.i) * (b.j - a.j) / (b.i - a.i));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (std::size_t k = 0; k + 1 < crossings.size(); k += 2) {
+            const int j0 = std::max(0, static_cast<int>(std::ceil(crossings[k])));
+            const int j1 = std::min(cols_, static_cast<int>(std::ceil(crossings[k + 1])));
+            if (j0 < j1) {
+                fillSpan(i, j0, j1, value);
+                markDirty({i, j0, i + 1, j1});
+            }
+        }
+    }
+}
+
+// Narrows [lo, hi] to the x with low <= c0 + c1 * x <= high.
+static void constrain(double c0, double c1, double low, double high, double &lo, double &hi) {
+    if (c1 == 0.0) {
+        if (c0 < low || c0 > high) {
+            lo = 1.0;
+            hi = 0.0;
+        }
+        return;
+    }
+    double x0 = (low - c0) / c1, x1 = (high - c0) / c1;
+    if (c1 < 0.0) {
+        std::swap(x0, x1);
+    }
+    lo = std::max(lo, x0);
+    hi = std::min(hi, x1);
+}
+
+void ConductorMask::stroke(MaskPoint a, MaskPoint b, double radius, bool value) {
+    radius = std::max(radius, 0.0);
+    const double di = b.i - a.i, dj = b.j - a.j;
+    const double length = std::sqrt(di * di + dj * dj);
+
+    const int first = std::max(0, static_cast<int>(std::ceil(std::min(a.i, b.i) - radius)));
+    const int last = std::min(rows_ - 1, static_cast<int>(std::floor(std::max(a.i, b.i) + radius)));
+    for (int i = first; i <= last; i++) {
+        // The brush covers the two end discs and the band between them;
+        // their union is convex, so each row meets it in one interval.
+        double lo = INFINITY, hi = -INFINITY;
+        for (const MaskPoint &end: {a, b}) {
+            const double h = radius * radius - (i - end.i) * (i - end.i);
+            if (h >= 0.0) {
+                lo = std::min(lo, end.j - std::sqrt(h));
+                hi = std::max(hi, end.j + std::sqrt(h));
+            }
+        }
+        if (length > 0.0) {
+            double bandLo = -INFINITY, bandHi = INFINITY;
+            // Projection onto the segment within [0, length], distance
+            // from its line within radius.
+            constrain((i - a.i) * di / length - a.j * dj / length, dj / length, 0.0, length, bandLo, bandHi);
+            constrain(((i - a.i) * dj + a.j * di) / length, -di / length, -radius, radius, bandLo, bandHi);
+            if (bandLo <= bandHi) {
+                lo = std::min(lo, bandLo);
+                hi = std::max(hi, bandHi);
+            }
+        }
+
+        const int j0 = std::max(0, static_cast<int>(std::ceil(lo)));
+        const int j1 = std::min(cols_, static_cast<int>(std::floor(hi)) + 1);
+        if (lo <= hi && j0 < j1) {
+            fillSpan(i, j0, j1, value);
+            markDirty({i, j0, i + 1, j1});
+        }
+    }
+}
+
+void ConductorMask::assign(const ConductorMask &other) {
+    std::copy(other.words.begin(), other.words.end(), words.begin());
+    markDirty({0, 0, rows_, cols_});
+}
+
+MaskRect ConductorMask::takeDirty() {
+    MaskRect rect = dirtyRect;
+    dirtyRect = {};
+    return rect;
+}
+
+long ConductorMask::count() const {
+    long total = 0;
+    for (Word word: words) {
+        total += std::popcount(word);
+    }
+    return total;
+}
+
+void ConductorMask::fillSpan(int i, int j0, int j1, bool value) {
+    Word *r = row(i);
+    const int w0 = j0 / kWordBits, w1 = (j1 - 1) / kWordBits;
+    const Word head = ~Word(0) << (j0 % kWordBits);
+    const Word tail = ~Word(0) >> (kWordBits - 1 - (j1 - 1) % kWordBits);
+
+    auto apply = [&](int w, Word bits) { r[w] = value ? r[w] | bits : r[w] & ~bits; };
+    if (w0 == w1) {
+        apply(w0, head & tail);
+        return;
+    }
+    apply(w0, head);
+    std::fill(r + w0 + 1, r + w1, value ? ~Word(0) : Word(0));
+    apply(w1, tail);
+}
+
+void ConductorMask::markDirty(const MaskRect &rect) {
+    dirtyRect = dirtyRect.merged(rect);
+}
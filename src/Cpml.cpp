@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Cpml.hpp"
+#include "Simulation.hpp"
+
+
+template <typename S, typename C>
+BasicCpml<S, C>::BasicCpml(Simulation &sim, const CpmlParameters &parameters)
+    : sim(sim), params(parameters),
+        psiEzx(2 * parameters.thickness + 1, sim.N, 0), psiHyx(2 * parameters.thickness + 1, sim.N, 0),
+        psiEzy(sim.M, 2 * parameters.thickness + 1, 0), psiHxy(sim.M, 2 * parameters.thickness + 1, 0) {
+    buildAxis(x, sim.M, sim.Cdtds);
+    buildAxis(y, sim.N, sim.Cdtds);
+}
+
+template <typename S, typename C>
+bool BasicCpml<S, C>::fits(int m, int n, int thickness) {
+    return thickness > 0 && 2 * thickness + 2 <= std::min(m, n);
+}
+
+template <typename S, typename C>
+void BasicCpml<S, C>::buildAxis(Axis &axis, int size, C courant) {
+    const int d = params.thickness;
+    axis.size = size;
+    axis.thickness = d;
+
+    const double m = params.grading;
+    const double sigmaMax = params.sigmaScale * 0.8 * (m + 1.0) * courant;
+
+    // depth is measured in cells from the inner edge of the layer.
+    auto profile = [&](double depth, C &b, C &c, C &k) {
+        double p = std::clamp(depth / d, 0.0, 1.0);
+        double sigma = sigmaMax * std::pow(p, m);
+        double kappa = 1.0 + (params.kappaMax - 1.0) * std::pow(p, m);
+        double alpha = params.alphaMax * (1.0 - p);
+        double bValue = std::exp(-(sigma / kappa + alpha));
+        b = C(bValue);
+        c = C(sigma > 0.0 ? sigma * (bValue - 1.0) / (sigma * kappa + kappa * kappa * alpha) : 0.0);
+        k = C(1.0 / kappa - 1.0);
+    };
+
+    const int count = axis.slabSize();
+    axis.bE.resize(count);
+    axis.cE.resize(count);
+    axis.kE.resize(count);
+    axis.bH.resize(count);
+    axis.cH.resize(count);
+    axis.kH.resize(count);
+    for (int k = 0; k < count; k++) {
+        const int i = axis.cell(k);
+        const bool low = k < d;
+        // E_z sits on cell i, H half a cell towards higher i.
+        double depthE = low ? d - i : i - axis.highBegin();
+        double depthH = low ? d - i - 0.5 : i + 0.5 - axis.highBegin();
+        profile(depthE, axis.bE[k], axis.cE[k], axis.kE[k]);
+        profile(depthH, axis.bH[k], axis.cH[k], axis.kH[k]);
+    }
+}
+
+template <typename S, typename C>
+void BasicCpml<S, C>::correctElectricRows(int rowBegin, int rowEnd) {
+    const int N = sim.N;
+    const auto &materials = sim.materials;
+    const int count = y.slabSize();
+
+    for (int mm = std::max(rowBegin, 1); mm < std::min(rowEnd, sim.M - 1); ++mm) {
+        S *ez = sim.E_z.row(mm);
+        const S *hy = sim.H_y.row(mm);
+        const S *hyPrev = sim.H_y.row(mm-1);
+        const S *hx = sim.H_x.row(mm);
+        const std::uint8_t *material = sim.material.row(mm);
+        const ConductorMask::Word *conductor = sim.conductors.row(mm);
+
+        // Top and bottom slabs: whole rows.
+        const int kx = x.index(mm);
+        if (kx >= 0) {
+            const C b = x.bE[kx], c = x.cE[kx], k = x.kE[kx];
+            C *psi = psiEzx.row(kx);
+            for (int nn = 1; nn < N-1; ++nn) {
+                C d = C(hy[nn]) - C(hyPrev[nn]);
+                psi[nn] = b * psi[nn] + c * d;
+                if (!ConductorMask::test(conductor, nn)) {
+                    ez[nn] = S(C(ez[nn]) + materials[material[nn]].ezh * (k * d + psi[nn]));
+                }
+            }
+        }
+
+        // Left and right slabs.
+        C *psi = psiEzy.row(mm);
+        for (int k = 0; k < count; ++k) {
+            const int nn = y.cell(k);
+            if (nn < 1 || nn >= N-1) {
+                continue;
+            }
+            C d = C(hx[nn]) - C(hx[nn-1]);
+            psi[k] = y.bE[k] * psi[k] + y.cE[k] * d;
+            if (!ConductorMask::test(conductor, nn)) {
+                ez[nn] = S(C(ez[nn]) - materials[material[nn]].ezh * (y.kE[k] * d + psi[k]));
+            }
+        }
+    }
+}
+
+template <typename S, typename C>
+void BasicCpml<S, C>::correctMagneticRows(int rowBegin, int rowEnd) {
+    const int M = sim.M;
+    const int N = sim.N;
+    const auto &materials = sim.materials;
+    const int count = y.slabSize();
+
+    for (int mm = rowBegin; mm < rowEnd; ++mm) {
+        const S *ez = sim.E_z.row(mm);
+        const std::uint8_t *material = sim.material.row(mm);
+
+        // H_x in the left and right slabs; column N-1 is off the grid.
+        S *hx = sim.H_x.row(mm);
+        C *psi = psiHxy.row(mm);
+        for (int k = 0; k < count; ++k) {
+            const int nn = y.cell(k);
+            if (nn >= N-1) {
+                continue;
+            }
+            C d = C(ez[nn+1]) - C(ez[nn]);
+            psi[k] = y.bH[k] * psi[k] + y.cH[k] * d;
+            hx[nn] = S(C(hx[nn]) - materials[material[nn]].hxe * (y.kH[k] * d + psi[k]));
+        }
+
+        // H_y in the top and bottom slabs; row M-1 is off the grid.
+        const int kx = x.index(mm);
+        if (kx >= 0 && mm < M-1) {
+            const C b = x.bH[kx], c = x.cH[kx], k = x.kH[kx];
+            const S *ezNext = sim.E_z.row(mm+1);
+            S *hy = sim.H_y.row(mm);
+            C *psiRow = psiHyx.row(kx);
+            for (int nn = 0; nn < N; ++nn) {
+                C d = C(ezNext[nn]) - C(ez[nn]);
+                psiRow[nn] = b * psiRow[nn] + c * d;
+                hy[nn] = S(C(hy[nn]) + materials[material[nn]].hye * (k * d + psiRow[nn]));
+            }
+        }
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicCpml<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unistd.h>
+
+#include "CpuBackend.hpp"
+#include "Simulation.hpp"
+
+
+template <typename S, typename C>
+BasicCpuBackend<S, C>::BasicCpuBackend(Simulation &sim, int threads, int firstCpu)
+    : BasicBackend<S, C>(sim), pool(threads, firstCpu), kernels(&selectKernels<S, C>()), activity(sim.M, sim.N) {}
+
+
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::stepElectricField() {
+    sim.refreshRowSpans();
+    sim.dispersion.refresh();
+    activity.fill();
+    rescanAll = true;
+    pool.parallelFor(1, sim.M - 1, [this](int rowBegin, int rowEnd) {
+        updateElectricRows(rowBegin, rowEnd);
+    });
+}
+
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::stepMagneticField() {
+    sim.refreshRowSpans();
+    activity.fill();
+    rescanAll = true;
+    pool.parallelFor(0, sim.M, [this](int rowBegin, int rowEnd) {
+        updateMagneticRows(rowBegin, rowEnd);
+    });
+}
+
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::setTiling(int stepsPerTile, int rowsPerTile) {
+    tileSteps = stepsPerTile;
+    tileRows = rowsPerTile;
+}
+
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::setActivityTracking(bool enabled, double threshold) {
+    trackActivity = enabled;
+    activityThreshold = threshold;
+    activity.fill();
+    rescanAll = true;
+}
+
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::advance(int steps) {
+    if (steps <= 0) {
+        return;
+    }
+    sim.refreshRowSpans();
+    sim.dispersion.refresh();
+
+    // Accumulate the time the same way repeated single steps would. The
+    // sources were tabulated for these steps by Simulation::advance().
+    for (int step = 0; step < steps; step++) {
+        sim.time += sim.deltaT;
+    }
+
+    // The activity map stays valid for half a tile of steps. A full map
+    // is valid for any number, so while the grid stays busy the map is
+    // refreshed less and less often, only to notice it quieting down.
+    int backoff = 1;
+    for (int first = 0; first < steps;) {
+        refreshActivity();
+        int period = trackActivity ? ActivityMap::kTileSize / 2 : steps;
+        if (trackActivity && activity.full()) {
+            period *= backoff;
+            backoff = std::min(2 * backoff, 64);
+        } else {
+            backoff = 1;
+        }
+        const int chunk = std::min(steps - first, period);
+        if (tileSteps > 1 && chunk > 1) {
+            advanceTiled(first, chunk);
+        } else {
+            advanceStepwise(first, chunk);
+        }
+        first += chunk;
+    }
+}
+
+// Keeps the tiles that hold a field above the threshold, plus the sources,
+// the CPML slabs, the plane wave's edges and the dispersive cells, and
+// their neighbours. Tiles outside the old map are known to be zero, so
+// only the old map is scanned.
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::refreshActivity() {
+    if (!trackActivity) {
+        return;
+    }
+    const int tileCols = activity.tileCols();
+    tileActive.assign(static_cast<std::size_t>(activity.tileRows()) * tileCols, 0);
+    pool.parallelFor(0, activity.tileRows(), 1, [&](int tileBegin, int tileEnd) {
+        for (int ti = tileBegin; ti < tileEnd; ti++) {
+            for (int tj = 0; tj < tileCols; tj++) {
+                if ((rescanAll || activity.active(ti, tj)) && !tileIsQuiet(ti, tj)) {
+                    tileActive[ti * tileCols + tj] = 1;
+                }
+            }
+        }
+    });
+    rescanAll = false;
+
+    activity.clear();
+    for (int ti = 0; ti < activity.tileRows(); ti++) {
+        for (int tj = 0; tj < tileCols; tj++) {
+            if (tileActive[ti * tileCols + tj]) {
+                activity.mark(ti, tj);
+            }
+        }
+    }
+    for (int k = 0; k < sim.sources.cellCount(); k++) {
+        const int i = sim.sources.cellRow(k), j = sim.sources.cellColumn(k);
+        activity.markCells(i, j, i + 1, j + 1);
+    }
+    if (sim.cpml) {
+        // The psi fields can drive a slab whose own fields are zero.
+        const int d = sim.cpml->parameters().thickness + 1;
+        activity.markCells(0, 0, d, sim.N);
+        activity.markCells(sim.M - d, 0, sim.M, sim.N);
+        activity.markCells(0, 0, sim.M, d);
+        activity.markCells(0, sim.N - d, sim.M, sim.N);
+    }
+    if (sim.tfsf) {
+        // The plane wave is fed in along the edges of its rectangle.
+        const MaskRect &r = sim.tfsf->parameters().region;
+        activity.markCells(r.i0 - 1, r.j0 - 1, r.i0 + 1, r.j1 + 1);
+        activity.markCells(r.i1 - 1, r.j0 - 1, r.i1 + 1, r.j1 + 1);
+        activity.markCells(r.i0 - 1, r.j0 - 1, r.i1 + 1, r.j0 + 1);
+        activity.markCells(r.i0 - 1, r.j1 - 1, r.i1 + 1, r.j1 + 1);
+    }
+    if (!sim.dispersion.empty()) {
+        // Polarization can outlast the field that drove it.
+        const MaskRect &b = sim.dispersion.bounds();
+        activity.markCells(b.i0, b.j0, b.i1, b.j1);
+    }
+    activity.dilate();
+}
+
+template <typename S, typename C>
+bool BasicCpuBackend<S, C>::tileIsQuiet(int ti, int tj) const {
+    const C threshold = C(activityThreshold);
+    const int i0 = ti * ActivityMap::kTileSize, i1 = std::min(sim.M, i0 + ActivityMap::kTileSize);
+    const int j0 = tj * ActivityMap::kTileSize, j1 = std::min(sim.N, j0 + ActivityMap::kTileSize);
+    for (const Linear2DVector<S> *field: {&sim.E_z, &sim.H_x, &sim.H_y}) {
+        for (int i = i0; i < i1; i++) {
+            const S *values = field->row(i);
+            for (int j = j0; j < j1; j++) {
+                // Written so that NaN counts as active.
+                if (!(std::abs(C(values[j])) <= threshold)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// One dispatch for all steps; workers keep their rows and meet at a
+// barrier after each half-step.
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::advanceStepwise(int firstLevel, int steps) {
+    const int M = sim.M;
+    pool.run([&](int worker) {
+        int eBegin, eEnd, hBegin, hEnd;
+        ThreadPool::partition(1, M-1, worker, pool.size(), eBegin, eEnd);
+        ThreadPool::partition(0, M, worker, pool.size(), hBegin, hEnd);
+
+        for (int level = 0; level < steps; level++) {
+            updateElectricRows(eBegin, eEnd);
+            sim.sources.applyElectricRows(firstLevel + level, eBegin, eEnd);
+            if (sim.tfsf) {
+                sim.tfsf->correctElectricRows(firstLevel + level, eBegin, eEnd);
+            }
+            sim.probes.sampleElectricRows(firstLevel + level, eBegin, eEnd);
+            sim.dft.accumulateElectricRows(firstLevel + level, eBegin, eEnd);
+            pool.barrier();
+            updateMagneticRows(hBegin, hEnd);
+            if (sim.tfsf) {
+                sim.tfsf->correctMagneticRows(firstLevel + level, hBegin, hEnd);
+            }
+            sim.probes.sampleMagneticRows(firstLevel + level, hBegin, hEnd);
+            sim.dft.accumulateMagneticRows(firstLevel + level, hBegin, hEnd);
+            pool.barrier();
+        }
+    });
+}
+
+// Band b at level k (the k-th step of the tile) updates E rows
+// [b*rows - k, (b+1)*rows - k) and the H rows one above that. Everything
+// it reads is either its own or was produced by band b-1 at level k, and
+// nothing band b-1 does at later levels touches those rows, so the only
+// synchronization needed is "band b-1 has finished level k".
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::advanceTiled(int firstLevel, int steps) {
+    const int M = sim.M;
+    const int depth = std::min(tileSteps, steps);
+    const int rows = bandRows(depth);
+    const int bands = (M + depth + rows - 1) / rows;
+
+    // Levels completed by each band, counted over the whole call.
+    std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[bands]);
+    for (int band = 0; band < bands; band++) {
+        progress[band].store(0);
+    }
+
+    pool.run([&](int worker) {
+        for (int first = 0; first < steps; first += depth) {
+            const int levels = std::min(depth, steps - first);
+
+            for (int band = worker; band < bands; band += pool.size()) {
+                const int base = band * rows;
+                for (int k = 0; k < levels; k++) {
+                    const int level = first + k;
+                    if (band > 0) {
+                        int done;
+                        while ((done = progress[band-1].load(std::memory_order_acquire)) <= level) {
+                            progress[band-1].wait(done, std::memory_order_acquire);
+                        }
+                    }
+
+                    const int eBegin = std::max(1, base - k);
+                    const int eEnd = std::min(M-1, base + rows - k);
+                    if (eBegin < eEnd) {
+                        updateElectricRows(eBegin, eEnd);
+                        sim.sources.applyElectricRows(firstLevel + level, eBegin, eEnd);
+                        if (sim.tfsf) {
+                            sim.tfsf->correctElectricRows(firstLevel + level, eBegin, eEnd);
+                        }
+                        sim.probes.sampleElectricRows(firstLevel + level, eBegin, eEnd);
+                        sim.dft.accumulateElectricRows(firstLevel + level, eBegin, eEnd);
+                    }
+
+                    const int hBegin = std::max(0, base - k - 1);
+                    const int hEnd = std::min(M, base + rows - k - 1);
+                    if (hBegin < hEnd) {
+                        updateMagneticRows(hBegin, hEnd);
+                        if (sim.tfsf) {
+                            sim.tfsf->correctMagneticRows(firstLevel + level, hBegin, hEnd);
+                        }
+                        sim.probes.sampleMagneticRows(firstLevel + level, hBegin, hEnd);
+                        sim.dft.accumulateMagneticRows(firstLevel + level, hBegin, hEnd);
+                    }
+
+                    progress[band].store(level + 1, std::memory_order_release);
+                    progress[band].notify_all();
+                }
+            }
+
+            // The next tile starts back at band 0, which would overwrite
+            // rows the last bands of this tile still need.
+            pool.barrier();
+        }
+    });
+}
+
+// Rows per band: as many as fit in L2 together with the rows the skew
+// adds, but small enough to give every worker a few bands.
+template <typename S, typename C>
+int BasicCpuBackend<S, C>::bandRows(int depth) const {
+    if (tileRows > 0) {
+        return std::max(2, tileRows);
+    }
+
+    long cacheBytes = 1 << 20;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (reported > 0) {
+        cacheBytes = reported;
+    }
+#endif
+    // E_z, H_x, H_y, the material index and the conductor bits
+    const long bytesPerRow = 3L * sim.E_z.pitch() * sizeof(S) + sim.material.pitch() +
+        sim.conductors.pitch() * sizeof(ConductorMask::Word);
+    int rows = static_cast<int>(cacheBytes / bytesPerRow) - depth - 2;
+    rows = std::min(rows, sim.M / (2 * pool.size()));
+    return std::max(2, rows);
+}
+
+// Calls uniform(span material, begin, end), mixed(begin, end) or
+// conductor(begin, end) for each span of a row clipped to [lo, hi).
+template <typename Uniform, typename Mixed, typename Conductor>
+static void forEachSpan(const std::vector<RowSpan> &spans, int lo, int hi,
+    Uniform uniform, Mixed mixed, Conductor conductor) {
+    for (const RowSpan &span: spans) {
+        int begin = std::max(span.begin, lo);
+        int end = std::min(span.end, hi);
+        if (begin >= end) {
+            continue;
+        }
+        if (span.material >= 0) {
+            uniform(span.material, begin, end);
+        } else if (span.material == RowSpan::kConductor) {
+            conductor(begin, end);
+        } else {
+            mixed(begin, end);
+        }
+    }
+}
+
+// Rows [rowBegin, rowEnd) of E_z, within [1, M-1).
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::updateElectricRows(int rowBegin, int rowEnd) {
+    const int N = sim.N;
+    const auto &materials = sim.materials;
+    const C *coefficients = &materials[0].eze;
+    for (int mm = rowBegin; mm < rowEnd; ++mm) {
+        ElectricRow<S, C> row{sim.E_z.row(mm), sim.H_y.row(mm), sim.H_y.row(mm-1), sim.H_x.row(mm),
+            sim.material.row(mm), sim.conductors.row(mm), coefficients};
+        for (const ActivityMap::Run &run: activity.runs(mm)) {
+            forEachSpan(sim.electricSpans(mm), std::max(1, run.begin), std::min(N-1, run.end),
+                [&](int id, int begin, int end) {
+                    kernels->electricRowUniform(row, materials[id].eze, materials[id].ezh, begin, end);
+                },
+                [&](int begin, int end) { kernels->electricRow(row, begin, end); },
+                [&](int begin, int end) { std::fill(row.ez + begin, row.ez + end, S(0.0f)); });
+        }
+    }
+
+    if (sim.cpml) {
+        sim.cpml->correctElectricRows(rowBegin, rowEnd);
+    }
+    if (!sim.dispersion.empty()) {
+        sim.dispersion.correctElectricRows(*kernels, rowBegin, rowEnd);
+    }
+}
+
+// Rows [rowBegin, rowEnd) of H_x and of H_y, within [0, M). Both cover
+// the full M x N shape; the extra column of H_x and row of H_y read the
+// halo and the PEC boundary and so stay zero.
+template <typename S, typename C>
+void BasicCpuBackend<S, C>::updateMagneticRows(int rowBegin, int rowEnd) {
+    const int N = sim.N;
+    const auto &materials = sim.materials;
+    auto none = [](int, int) {};
+
+    for (int mm = rowBegin; mm < rowEnd; ++mm) {
+        const std::vector<RowSpan> &spans = sim.magneticSpans(mm);
+        MagneticRow<S, C> x{sim.H_x.row(mm), sim.E_z.row(mm), nullptr, sim.material.row(mm), &materials[0].hxh};
+        MagneticRow<S, C> y{sim.H_y.row(mm), sim.E_z.row(mm), sim.E_z.row(mm+1), sim.material.row(mm), &materials[0].hyh};
+        for (const ActivityMap::Run &run: activity.runs(mm)) {
+            forEachSpan(spans, run.begin, std::min(N, run.end),
+                [&](int id, int begin, int end) {
+                    kernels->magneticXRowUniform(x, materials[id].hxh, materials[id].hxe, begin, end);
+                },
+                [&](int begin, int end) { kernels->magneticXRow(x, begin, end); }, none);
+            forEachSpan(spans, run.begin, std::min(N, run.end),
+                [&](int id, int begin, int end) {
+                    kernels->magneticYRowUniform(y, materials[id].hyh, materials[id].hye, begin, end);
+                },
+                [&](int begin, int end) { kernels->magneticYRow(y, begin, end); }, none);
+        }
+    }
+
+    if (sim.cpml) {
+        sim.cpml->correctMagneticRows(rowBegin, rowEnd);
+    }
+}
+
+template <typename S, typename C>
+S *BasicCpuBackend<S, C>::electricField() {
+    return sim.E_z.origin();
+}
+
+template <typename S, typename C>
+std::uint8_t *BasicCpuBackend<S, C>::materialField() {
+    return sim.material.origin();
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicCpuBackend<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
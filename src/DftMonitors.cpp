@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "DftMonitors.hpp"
+#include "FileIO.hpp"
+#include "Simulation.hpp"
+
+static const char kFileMagic[8] = {'E', 'M', 'S', 'I', 'M', 'D', 'F', 'T'};
+constexpr std::uint32_t kDftVersion = 1;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t field;
+    std::int32_t i0, j0, i1, j1;
+    std::uint32_t frequencyCount;
+    std::uint32_t reserved;
+    std::int64_t steps;
+};
+
+static std::size_t cellCount(const MaskRect &region) {
+    return static_cast<std::size_t>(region.i1 - region.i0) * (region.j1 - region.j0);
+}
+
+template <typename S, typename C>
+int BasicDftMonitorSet<S, C>::add(const std::string &name, FieldComponent field, const MaskRect &region,
+    const std::vector<double> &frequencies) {
+    if (region.empty() || region.i0 < 0 || region.j0 < 0 || region.i1 > sim.M || region.j1 > sim.N ||
+        frequencies.empty()) {
+        return -1;
+    }
+    monitors.push_back({name, field, region, frequencies});
+    accumulators.emplace_back(2 * frequencies.size() * cellCount(region), C(0));
+    firstFrequency.push_back(firstFrequency.back() + static_cast<int>(frequencies.size()));
+    return monitorCount() - 1;
+}
+
+template <typename S, typename C>
+void BasicDftMonitorSet<S, C>::clear() {
+    monitors.clear();
+    accumulators.clear();
+    firstFrequency.assign(1, 0);
+    stepsDone = 0;
+}
+
+template <typename S, typename C>
+void BasicDftMonitorSet<S, C>::reset() {
+    for (std::vector<C> &sum: accumulators) {
+        std::fill(sum.begin(), sum.end(), C(0));
+    }
+    stepsDone = 0;
+}
+
+template <typename S, typename C>
+std::complex<double> BasicDftMonitorSet<S, C>::value(int m, int f, int i, int j) const {
+    const MaskRect &region = monitors[m].region;
+    const std::size_t cells = cellCount(region);
+    const std::size_t cell = static_cast<std::size_t>(i - region.i0) * (region.j1 - region.j0) + (j - region.j0);
+    const C *sum = &accumulators[m][2 * f * cells];
+    return {double(sum[cell]), double(sum[cells + cell])};
+}
+
+template <typename S, typename C>
+int BasicDftMonitorSet<S, C>::prepare(int steps, double startTime) {
+    if (empty()) {
+        return steps;
+    }
+    steps = std::min(steps, kMaxLevels);
+    const int frequencies = firstFrequency.back();
+    electricPhases.resize(static_cast<std::size_t>(steps) * frequencies * 2);
+    magneticPhases.resize(electricPhases.size());
+
+    const double dt = sim.deltaT;
+    for (int m = 0; m < monitorCount(); m++) {
+        for (std::size_t f = 0; f < monitors[m].frequencies.size(); f++) {
+            const double omega = 2.0 * std::numbers::pi * monitors[m].frequencies[f];
+            // Rotating in double keeps the drift far below float resolution
+            // over kMaxLevels steps.
+            std::complex<double> phase = std::polar(dt, -omega * startTime);
+            const std::complex<double> rotation = std::polar(1.0, -omega * dt);
+            const std::complex<double> halfStep = std::polar(1.0, -omega * dt / 2);
+            for (int level = 0; level < steps; level++) {
+                const std::size_t k = (static_cast<std::size_t>(level) * frequencies + firstFrequency[m] + f) * 2;
+                const std::complex<double> magnetic = phase * halfStep;
+                electricPhases[k] = C(phase.real());
+                electricPhases[k + 1] = C(phase.imag());
+                magneticPhases[k] = C(magnetic.real());
+                magneticPhases[k + 1] = C(magnetic.imag());
+                phase *= rotation;
+            }
+        }
+    }
+    return steps;
+}
+
+template <typename S, typename C>
+void BasicDftMonitorSet<S, C>::accumulate(FieldComponent field, int level, int rowBegin, int rowEnd) {
+    const Linear2DVector<S> &values = sim.field(field);
+    const std::vector<C> &phases = field == FieldComponent::Ez ? electricPhases : magneticPhases;
+    const C *levelPhases = &phases[static_cast<std::size_t>(level) * firstFrequency.back() * 2];
+
+    for (int m = 0; m < monitorCount(); m++) {
+        const DftMonitor &monitor = monitors[m];
+        if (monitor.field != field) {
+            continue;
+        }
+        const MaskRect &region = monitor.region;
+        const int width = region.j1 - region.j0;
+        const std::size_t cells = cellCount(region);
+        const C *phase = levelPhases + 2 * firstFrequency[m];
+        // Row by row, so each row is read from cache for every frequency.
+        for (int i = std::max(rowBegin, region.i0); i < std::min(rowEnd, region.i1); i++) {
+            const S *row = values.row(i) + region.j0;
+            C *sum = &accumulators[m][static_cast<std::size_t>(i - region.i0) * width];
+            for (std::size_t f = 0; f < monitor.frequencies.size(); f++) {
+                kernels.dftRow(row, sum, sum + cells, phase[2 * f], phase[2 * f + 1], width);
+                sum += 2 * cells;
+            }
+        }
+    }
+}
+
+template <typename S, typename C>
+void BasicDftMonitorSet<S, C>::accumulateElectricRows(int level, int rowBegin, int rowEnd) {
+    if (empty() || rowBegin >= rowEnd) {
+        return;
+    }
+    accumulate(FieldComponent::Ez, level, rowBegin == 1 ? 0 : rowBegin, rowEnd == sim.M - 1 ? sim.M : rowEnd);
+}
+
+template <typename S, typename C>
+void BasicDftMonitorSet<S, C>::accumulateMagneticRows(int level, int rowBegin, int rowEnd) {
+    if (empty()) {
+        return;
+    }
+    accumulate(FieldComponent::Hx, level, rowBegin, rowEnd);
+    accumulate(FieldComponent::Hy, level, rowBegin, rowEnd);
+}
+
+template <typename S, typename C>
+bool BasicDftMonitorSet<S, C>::write(int m, const std::string &path, std::string &error) const {
+    const DftMonitor &monitor = monitors[m];
+    FileHeader header{};
+    std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = kDftVersion;
+    header.field = static_cast<std::uint32_t>(monitor.field);
+    header.i0 = monitor.region.i0;
+    header.j0 = monitor.region.j0;
+    header.i1 = monitor.region.i1;
+    header.j1 = monitor.region.j1;
+    header.frequencyCount = static_cast<std::uint32_t>(monitor.frequencies.size());
+    header.steps = stepsDone;
+
+    const std::vector<float> sums(accumulators[m].begin(), accumulators[m].end());
+    const std::uint64_t frequencyBytes = monitor.frequencies.size() * sizeof(double);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && writeAll(fd, &header, sizeof(header), 0) &&
+        writeAll(fd, monitor.frequencies.data(), frequencyBytes, sizeof(header)) &&
+        writeAll(fd, sums.data(), sums.size() * sizeof(float), sizeof(header) + frequencyBytes);
+    if (fd >= 0) {
+        ok = ::close(fd) == 0 && ok;
+    }
+    if (!ok) {
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicDftMonitorSet<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "Dispersion.hpp"
+#include "Simulation.hpp"
+
+bool parseDispersivePoleKind(const std::string &name, DispersivePole::Kind &kind) {
+    static const char *const names[] = {"drude", "lorentz", "debye"};
+    for (int k = 0; k < 3; k++) {
+        if (name == names[k]) {
+            kind = static_cast<DispersivePole::Kind>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename S, typename C>
+bool BasicDispersion<S, C>::addPole(int material, const DispersivePole &pole) {
+    using Kind = DispersivePole::Kind;
+    if (material < 1 || material >= static_cast<int>(sim.materials.size())) {
+        return false;
+    }
+    bool valid = false;
+    switch (pole.kind) {
+    case Kind::Drude:
+        valid = pole.frequency > 0.0 && pole.damping >= 0.0;
+        break;
+    case Kind::Lorentz:
+        valid = pole.deltaEpsilon > 0.0 && pole.frequency > 0.0 && pole.damping >= 0.0;
+        break;
+    case Kind::Debye:
+        valid = pole.deltaEpsilon > 0.0 && pole.relaxationTime > 0.0;
+        break;
+    }
+    if (!valid) {
+        return false;
+    }
+
+    auto group = std::find_if(groups.begin(), groups.end(), [&](const Group &g) { return g.material == material; });
+    if (group == groups.end()) {
+        groups.push_back({material, {}, 0, 0, {}, 0, C(0), C(0)});
+        group = groups.end() - 1;
+    }
+    if (static_cast<int>(group->poles.size()) >= kMaxPoles) {
+        return false;
+    }
+    group->poles.push_back({pole, {}});
+    // The state arrays change shape; rebuild() starts the group from zero.
+    group->count = -1;
+    stale = true;
+    return true;
+}
+
+template <typename S, typename C>
+void BasicDispersion<S, C>::clear() {
+    groups.clear();
+    columns.clear();
+    polarization.clear();
+    history.clear();
+    electric.clear();
+    cellBounds = {};
+    stale = false;
+}
+
+// Lists the cells of every dispersive material, keeping the polarization
+// of cells that were already listed.
+template <typename S, typename C>
+void BasicDispersion<S, C>::rebuild() {
+    stale = false;
+    if (groups.empty()) {
+        return;
+    }
+    const std::vector<Group> old = groups;
+    const std::vector<int> oldColumns = std::move(columns);
+    const std::vector<C> oldPolarization = std::move(polarization);
+
+    int groupOf[kMaxMaterials];
+    std::fill(groupOf, groupOf + kMaxMaterials, -1);
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        groupOf[groups[g].material] = static_cast<int>(g);
+    }
+
+    std::vector<std::vector<int>> cells(groups.size());
+    for (Group &group: groups) {
+        group.rowFirst.assign(sim.M + 1, 0);
+    }
+    cellBounds = {};
+    for (int i = 0; i < sim.M; i++) {
+        const std::uint8_t *row = sim.material.row(i);
+        for (int j = 0; j < sim.N; j++) {
+            const int g = groupOf[row[j]];
+            if (g >= 0) {
+                cells[g].push_back(j);
+                groups[g].rowFirst[i + 1]++;
+                cellBounds = cellBounds.merged({i, j, i + 1, j + 1});
+            }
+        }
+    }
+
+    columns.clear();
+    std::size_t size = 0;
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        Group &group = groups[g];
+        for (int i = 0; i < sim.M; i++) {
+            group.rowFirst[i + 1] += group.rowFirst[i];
+        }
+        group.first = static_cast<int>(columns.size());
+        group.count = static_cast<int>(cells[g].size());
+        group.state = size;
+        columns.insert(columns.end(), cells[g].begin(), cells[g].end());
+        size += (1 + 2 * group.poles.size()) * group.count;
+    }
+    polarization.assign(size, C(0));
+    history.assign(columns.size(), C(0));
+    electric.assign(columns.size(), C(0));
+
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        const Group &before = old[g], &after = groups[g];
+        if (before.count <= 0 || after.count == 0) {
+            continue;
+        }
+        const int arrays = 1 + 2 * static_cast<int>(after.poles.size());
+        for (int i = 0; i < sim.M; i++) {
+            // Both rows are sorted by column.
+            int k = before.rowFirst[i];
+            for (int n = after.rowFirst[i]; n < after.rowFirst[i + 1]; n++) {
+                const int j = columns[after.first + n];
+                while (k < before.rowFirst[i + 1] && oldColumns[before.first + k] < j) {
+                    k++;
+                }
+                if (k == before.rowFirst[i + 1] || oldColumns[before.first + k] != j) {
+                    continue;
+                }
+                for (int a = 0; a < arrays; a++) {
+                    array(after, a)[n] = oldPolarization[before.state + static_cast<std::size_t>(a) * before.count + k];
+                }
+            }
+        }
+    }
+}
+
+template <typename S, typename C>
+void BasicDispersion<S, C>::refresh() {
+    using Kind = DispersivePole::Kind;
+    if (stale) {
+        rebuild();
+    }
+    // The bilinear transform, s -> k (1 - 1/z) / (1 + 1/z), of each pole's
+    // response P / E = drive / (s^2 + gamma s + w^2) or deltaEpsilon / (1 +
+    // tau s), solved for P[n+1].
+    const double k = 2.0 / sim.deltaT;
+    for (Group &group: groups) {
+        double drives = 0.0;
+        for (Pole &p: group.poles) {
+            const DispersivePole &pole = p.pole;
+            const double omega = 2.0 * std::numbers::pi * pole.frequency;
+            double alpha = 0.0, xi = 0.0, drive = 0.0, lead = 0.0, lag = 0.0;
+            switch (pole.kind) {
+            case Kind::Drude:
+            case Kind::Lorentz: {
+                const double w2 = pole.kind == Kind::Lorentz ? omega * omega : 0.0;
+                const double strength = pole.kind == Kind::Lorentz ? pole.deltaEpsilon * w2 : omega * omega;
+                const double d = k * k + pole.damping * k + w2;
+                alpha = 2.0 * (k * k - w2) / d;
+                xi = -(k * k - pole.damping * k + w2) / d;
+                drive = strength / d;
+                lead = 2.0 * drive;
+                lag = drive;
+                break;
+            }
+            case Kind::Debye: {
+                const double d = 1.0 + pole.relaxationTime * k;
+                alpha = (pole.relaxationTime * k - 1.0) / d;
+                drive = pole.deltaEpsilon / d;
+                lead = drive;
+                break;
+            }
+            }
+            p.step = {C(alpha), C(xi), C(drive), C(lead), C(lag)};
+            drives += drive;
+        }
+        // 1 / (epsr (1 + loss)), from the coefficients the kernels used.
+        const double s = double(sim.materials[group.material].ezh) / (double(sim.Cdtds) * double(sim.imp0));
+        group.solve = C(1.0 / (1.0 + s * drives));
+        group.solveHistory = C(s / (1.0 + s * drives));
+    }
+}
+
+template <typename S, typename C>
+void BasicDispersion<S, C>::correctElectricRows(const KernelTable<S, C> &kernels, int rowBegin, int rowEnd) {
+    for (Group &group: groups) {
+        const int lo = group.rowFirst[rowBegin], hi = group.rowFirst[rowEnd];
+        if (lo == hi) {
+            continue;
+        }
+        C *sum = history.data() + group.first;
+        C *next = electric.data() + group.first;
+        for (std::size_t p = 0; p < group.poles.size(); p++) {
+            kernels.poleHistory(array(group, 1 + 2 * p) + lo, array(group, 2 + 2 * p) + lo, sum + lo,
+                group.poles[p].step, hi - lo);
+        }
+
+        const int *column = columns.data() + group.first;
+        for (int i = rowBegin; i < rowEnd; i++) {
+            S *ez = sim.E_z.row(i);
+            const ConductorMask::Word *conductor = sim.conductors.row(i);
+            for (int n = group.rowFirst[i]; n < group.rowFirst[i + 1]; n++) {
+                const int j = column[n];
+                C value = group.solve * C(ez[j]) - group.solveHistory * sum[n];
+                if (ConductorMask::test(conductor, j)) {
+                    value = C(0);
+                }
+                ez[j] = S(value);
+                next[n] = value;
+                sum[n] = C(0);
+            }
+        }
+
+        C *previous = array(group, 0);
+        for (std::size_t p = 0; p < group.poles.size(); p++) {
+            kernels.poleStep(array(group, 1 + 2 * p) + lo, array(group, 2 + 2 * p) + lo, next + lo, previous + lo,
+                group.poles[p].step, hi - lo);
+        }
+        std::copy(next + lo, next + hi, previous + lo);
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicDispersion<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,29 @@
+#include "FieldRenderer.hpp"
+
+// Pixels per chunk handed to a render worker; smaller chunks cost more
+// in scheduling than they gain in balance.
+static constexpr int kChunkPixels = 8192;
+
+FieldRenderer::FieldRenderer(int rows, int cols, float width, float height)
+    : rows_(rows), cols_(cols),
+      chunkRows(ThreadPool::cacheAlignedRows(cols * int(sizeof(std::uint32_t)), kChunkPixels / cols)),
+      pixels(static_cast<size_t>(rows) * cols, packRgba(0, 0, 0)) {
+    texture.create(cols, rows);
+    texture.setSmooth(false);
+    sprite.setTexture(texture, true);
+    sprite.setScale(width / cols, height / rows);
+}
+
+void FieldRenderer::update(const float *field, int pitch, const ConductorMask &conductor,
+    ThreadPool &pool) {
+    const ColorRange range = colors.frameRange(field, pitch, rows_, cols_);
+    pool.parallelFor(0, rows_, chunkRows, [&](int rowBegin, int rowEnd) {
+        colors.colorizeRows(field, pitch, &conductor, pixels.data(), cols_,
+            rowBegin, rowEnd, cols_, range);
+    });
+    texture.update(reinterpret_cast<const sf::Uint8*>(pixels.data()));
+}
+
+void FieldRenderer::draw(sf::RenderWindow &window) const {
+    window.draw(sprite);
+}
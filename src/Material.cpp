@@ -0,0 +1,30 @@
+#include "Material.hpp"
+
+
+void buildRowSpans(const std::uint8_t *material, const ConductorMask::Word *conductor, int n, int minRun,
+    std::vector<RowSpan> &spans) {
+    spans.clear();
+
+    auto keyAt = [&](int j) {
+        return conductor && ConductorMask::test(conductor, j) ? RowSpan::kConductor : static_cast<int>(material[j]);
+    };
+
+    auto append = [&](int begin, int end, int key) {
+        if (end - begin < minRun) {
+            key = RowSpan::kMixed;
+        }
+        if (!spans.empty() && spans.back().material == RowSpan::kMixed && key == RowSpan::kMixed) {
+            spans.back().end = end;
+        } else {
+            spans.push_back({begin, end, key});
+        }
+    };
+
+    int begin = 0;
+    for (int j = 1; j <= n; j++) {
+        if (j == n || keyAt(j) != keyAt(begin)) {
+            append(begin, j, keyAt(begin));
+            begin = j;
+        }
+    }
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstring>
+
+#define NS_PRIVATE_IMPLEMENTATION
+#define CA_PRIVATE_IMPLEMENTATION
+#define MTL_PRIVATE_IMPLEMENTATION
+
+#include "MetalBackend.hpp"
+#include "Simulation.hpp"
+#include "Metal/MTLResource.hpp"
+
+// Coefficients are looked up per cell through the material index; the
+// table layout matches MaterialCoefficients<float>. The buffers hold the
+// whole padded grids, so each kernel maps its (i, j) to a storage index
+// through the Layout, which is the same for every float field and for
+// every byte field. The conductor mask is read as 32-bit words, which on
+// a little-endian GPU lay its 64-bit words out bit for bit.
+const char *computeCode = R"(
+    #include <metal_stdlib>
+    using namespace metal;
+
+    struct Coefficients {
+        float eze, ezh, hxh, hxe, hyh, hye;
+    };
+
+    struct Layout {
+        int M, N;
+        int pitch, origin;
+        int bytePitch, byteOrigin;
+        int maskPitch;
+    };
+    
+    kernel void updateElectricField(
+        device const uchar* material [[ buffer(0) ]],
+        device const Coefficients* table [[ buffer(1) ]],
+        device const float* H_y [[ buffer(2) ]],
+        device const float* H_x [[ buffer(3) ]],
+        device const uint* conductors [[ buffer(4) ]],
+        device float* E_z [[ buffer(5) ]],
+        constant Layout &L [[ buffer(6) ]],
+        uint idx [[ thread_position_in_grid ]]
+    ) {
+        int i = idx / L.N;
+        int j = idx % L.N;
+        if (1 <= i && i < L.M-1 && 1 <= j && j < L.N-1) {
+            int s = L.origin + i * L.pitch + j;
+            int b = L.byteOrigin + i * L.bytePitch + j;
+            if (((conductors[i * L.maskPitch + (j >> 5)] >> (j & 31)) & 1) == 0) {
+                Coefficients c = table[material[b]];
+                E_z[s] = c.eze * E_z[s] + c.ezh * ((H_y[s] - H_y[s - L.pitch]) - (H_x[s] - H_x[s - 1]));
+            } else {
+                E_z[s] = 0.0;
+            }
+        }
+    }
+    
+    // H_x and H_y share the M x N shape; the edge cells read the halo.
+    kernel void updateMagneticField(
+        device const uchar* material [[ buffer(0) ]],
+        device const Coefficients* table [[ buffer(1) ]],
+        device const float* E_z [[ buffer(2) ]],
+        device float* H_x [[ buffer(3) ]],
+        device float* H_y [[ buffer(4) ]],
+        constant Layout &L [[ buffer(5) ]],
+        uint idx [[thread_position_in_grid]]
+    ) {
+        int i = idx / L.N;
+        int j = idx % L.N;
+        int s = L.origin + i * L.pitch + j;
+        Coefficients c = table[material[L.byteOrigin + i * L.bytePitch + j]];
+        H_x[s] = c.hxh * H_x[s] - c.hxe * (E_z[s + 1] - E_z[s]);
+        H_y[s] = c.hyh * H_y[s] + c.hye * (E_z[s + L.pitch] - E_z[s]);
+    })";
+
+struct GridLayout {
+    int M, N;
+    int pitch, origin;
+    int bytePitch, byteOrigin;
+    int maskPitch;  // in 32-bit words
+};
+
+
+template <typename T>
+static MTL::Buffer *newSharedBuffer(MTL::Device *device, Linear2DVector<T> &v) {
+    return device->newBuffer(v.storage(), v.storageSize() * sizeof(T), MTL::ResourceStorageModeShared);
+}
+
+template <typename T>
+static void copyToBuffer(MTL::Buffer *buffer, const Linear2DVector<T> &v) {
+    std::memcpy(buffer->contents(), v.storage(), v.storageSize() * sizeof(T));
+}
+
+template <typename T>
+static void copyFromBuffer(Linear2DVector<T> &v, MTL::Buffer *buffer) {
+    std::memcpy(v.storage(), buffer->contents(), v.storageSize() * sizeof(T));
+}
+
+
+MetalBackend::MetalBackend(Simulation &sim) : Backend(sim) {
+    device = MTL::CreateSystemDefaultDevice();
+    GridLayout layout = {sim.M, sim.N, sim.E_z.pitch(), static_cast<int>(sim.E_z.originOffset()),
+        sim.material.pitch(), static_cast<int>(sim.material.originOffset()),
+        static_cast<int>(sim.conductors.pitch() * sizeof(ConductorMask::Word) / sizeof(std::uint32_t))};
+    bufferLayout = device->newBuffer(&layout, sizeof(layout), MTL::ResourceStorageModeShared);
+
+    bufferE_z = newSharedBuffer(device, sim.E_z);
+    bufferH_x = newSharedBuffer(device, sim.H_x);
+    bufferH_y = newSharedBuffer(device, sim.H_y);
+
+    bufferMaterial = newSharedBuffer(device, sim.material);
+    bufferMaterials = device->newBuffer(kMaxMaterials * sizeof(MaterialCoefficients<float>), MTL::ResourceStorageModeShared);
+    materialsChanged();
+
+    bufferConductors = device->newBuffer(sim.conductors.storage(),
+        sim.conductors.storageSize() * sizeof(ConductorMask::Word), MTL::ResourceStorageModeShared);
+
+    error = nullptr;
+    library = device->newLibrary(NS::String::string(computeCode, NS::UTF8StringEncoding), nullptr, &error);
+    error = nullptr;
+
+    eFieldFunction = library->newFunction(NS::String::string("updateElectricField", NS::UTF8StringEncoding)); 
+    hFieldFunction = library->newFunction(NS::String::string("updateMagneticField", NS::UTF8StringEncoding));
+}
+
+
+void MetalBackend::stepElectricField() {
+    const int M = sim.M;
+    const int N = sim.N;
+    error = nullptr;
+    MTL::ComputePipelineState *pipelineState = device->newComputePipelineState(eFieldFunction, &error);
+    MTL::CommandQueue *commandQueue = device->newCommandQueue();
+    MTL::CommandBuffer *commandBuffer = commandQueue->commandBuffer();
+    
+    MTL::ComputeCommandEncoder *encoder = commandBuffer->computeCommandEncoder();
+
+    encoder->setComputePipelineState(pipelineState);
+    encoder->setBuffer(bufferMaterial, 0, 0);
+    encoder->setBuffer(bufferMaterials, 0, 1);
+    encoder->setBuffer(bufferH_y, 0, 2);
+    encoder->setBuffer(bufferH_x, 0, 3);
+    encoder->setBuffer(bufferConductors, 0, 4);
+    encoder->setBuffer(bufferE_z, 0, 5);
+    encoder->setBuffer(bufferLayout, 0, 6);
+
+    MTL::Size gridSize = MTL::Size(N * M, 1, 1);
+    auto max_threads = (int) pipelineState->maxTotalThreadsPerThreadgroup();
+    MTL::Size threadGroupSize = MTL::Size(std::min(max_threads, N * M), 1, 1);
+    
+    encoder->dispatchThreads(gridSize, threadGroupSize);
+    encoder->endEncoding();
+
+    commandBuffer->commit();
+
+    commandBuffer->waitUntilCompleted();
+
+    pipelineState->release();
+    commandQueue->release();
+    commandBuffer->release();
+    encoder->release();
+}
+
+
+void MetalBackend::stepMagneticField() {
+    const int M = sim.M;
+    const int N = sim.N;
+    error = nullptr;
+    MTL::ComputePipelineState *pipelineState = device->newComputePipelineState(hFieldFunction, &error);
+    MTL::CommandQueue *commandQueue = device->newCommandQueue();
+    MTL::CommandBuffer *commandBuffer = commandQueue->commandBuffer();
+
+    MTL::ComputeCommandEncoder *encoder = commandBuffer->computeCommandEncoder();
+
+    encoder->setComputePipelineState(pipelineState);
+    encoder->setBuffer(bufferMaterial, 0, 0);
+    encoder->setBuffer(bufferMaterials, 0, 1);
+    encoder->setBuffer(bufferE_z, 0, 2);
+    encoder->setBuffer(bufferH_x, 0, 3);
+    encoder->setBuffer(bufferH_y, 0, 4);
+    encoder->setBuffer(bufferLayout, 0, 5);
+
+    MTL::Size gridSize = MTL::Size(N * M, 1, 1);
+    auto max_threads = (int) pipelineState->maxTotalThreadsPerThreadgroup();
+    MTL::Size threadGroupSize = MTL::Size(std::min(max_threads, N * M), 1, 1);
+
+    encoder->dispatchThreads(gridSize, threadGroupSize);
+    encoder->endEncoding();
+
+    commandBuffer->commit();
+
+    commandBuffer->waitUntilCompleted();
+
+    pipelineState->release();
+    commandQueue->release();
+    commandBuffer->release();
+    encoder->release();
+}
+
+
+float *MetalBackend::electricField() {
+    return static_cast<float*>(bufferE_z->contents()) + sim.E_z.originOffset();
+}
+
+void MetalBackend::conductorsChanged(const MaskRect &rect) {
+    const std::size_t pitch = sim.conductors.pitch();
+    auto *words = static_cast<ConductorMask::Word*>(bufferConductors->contents());
+    std::memcpy(words + rect.i0 * pitch, sim.conductors.row(rect.i0),
+        (rect.i1 - rect.i0) * pitch * sizeof(ConductorMask::Word));
+}
+
+std::uint8_t *MetalBackend::materialField() {
+    return static_cast<std::uint8_t*>(bufferMaterial->contents()) + sim.material.originOffset();
+}
+
+void MetalBackend::materialsChanged() {
+    std::memcpy(bufferMaterials->contents(), sim.materials.data(),
+        sim.materials.size() * sizeof(MaterialCoefficients<float>));
+}
+
+void MetalBackend::fieldsChanged() {
+    copyToBuffer(bufferE_z, sim.E_z);
+    copyToBuffer(bufferH_x, sim.H_x);
+    copyToBuffer(bufferH_y, sim.H_y);
+    copyToBuffer(bufferMaterial, sim.material);
+}
+
+void MetalBackend::synchronize() {
+    copyFromBuffer(sim.E_z, bufferE_z);
+    copyFromBuffer(sim.H_x, bufferH_x);
+    copyFromBuffer(sim.H_y, bufferH_y);
+}
+
+
+MetalBackend::~MetalBackend() {
+    bufferE_z->release();
+    bufferH_x->release();
+    bufferH_y->release();
+    bufferMaterial->release();
+    bufferMaterials->release();
+    bufferLayout->release();
+    bufferConductors->release();
+    eFieldFunction->release();
+    hFieldFunction->release();
+    library->release();
+    device->release();
+}
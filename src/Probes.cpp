@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FileIO.hpp"
+#include "Probes.hpp"
+#include "Simulation.hpp"
+
+static const char kFileMagic[8] = {'E', 'M', 'S', 'I', 'M', 'P', 'R', 'B'};
+static const char kBlockMagic[4] = {'P', 'B', 'L', 'K'};
+constexpr std::uint32_t kProbeVersion = 1;
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t columnCount;
+};
+
+struct ColumnRecord {
+    char name[32];
+    std::uint32_t field;
+    std::int32_t i, j;
+};
+
+struct BlockHeader {
+    char magic[4];
+    std::uint32_t sampleCount;
+    std::int64_t firstStep;
+};
+
+template <typename S, typename C>
+BasicProbeSet<S, C>::~BasicProbeSet() {
+    std::string ignored;
+    closeOutput(ignored);
+}
+
+template <typename S, typename C>
+int BasicProbeSet<S, C>::addPoint(const std::string &name, FieldComponent field, int i, int j) {
+    if (i < 0 || i >= sim.M || j < 0 || j >= sim.N) {
+        return -1;
+    }
+    columns.push_back({name, field, i, j});
+    changed();
+    return columnCount() - 1;
+}
+
+template <typename S, typename C>
+int BasicProbeSet<S, C>::addLine(const std::string &name, FieldComponent field, int i0, int j0, int i1, int j1) {
+    if (std::min(i0, i1) < 0 || std::max(i0, i1) >= sim.M || std::min(j0, j1) < 0 || std::max(j0, j1) >= sim.N) {
+        return -1;
+    }
+    // One cell per step along the longer axis.
+    const int first = columnCount();
+    const int cells = std::max(std::abs(i1 - i0), std::abs(j1 - j0)) + 1;
+    for (int k = 0; k < cells; k++) {
+        const double t = cells > 1 ? double(k) / (cells - 1) : 0.0;
+        const int i = static_cast<int>(std::lround(i0 + t * (i1 - i0)));
+        const int j = static_cast<int>(std::lround(j0 + t * (j1 - j0)));
+        columns.push_back({name + "[" + std::to_string(k) + "]", field, i, j});
+    }
+    changed();
+    return first;
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::clear() {
+    columns.clear();
+    changed();
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::setCapacity(int steps) {
+    slots = std::max(1, steps);
+    changed();
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::discard() {
+    head = 0;
+    count = 0;
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::changed() {
+    discard();
+    stale = true;
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::rebuild() {
+    std::vector<int> order(columns.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        const ProbeColumn &x = columns[a], &y = columns[b];
+        return std::tie(x.field, x.i, x.j, a) < std::tie(y.field, y.i, y.j, b);
+    });
+
+    offsets.clear();
+    targets.clear();
+    const std::size_t pitch = sim.E_z.pitch();
+    for (int c: order) {
+        offsets.push_back(columns[c].i * pitch + columns[c].j);
+        targets.push_back(c);
+    }
+    for (int f = 0; f < kFieldComponentCount; f++) {
+        rowFirst[f].assign(sim.M + 1, 0);
+    }
+    // Counting sort of the probe ranges per row.
+    for (int k = 0; k < static_cast<int>(order.size()); k++) {
+        rowFirst[static_cast<int>(columns[order[k]].field)][columns[order[k]].i + 1]++;
+    }
+    int start = 0;
+    for (int f = 0; f < kFieldComponentCount; f++) {
+        rowFirst[f][0] = start;
+        for (int i = 1; i <= sim.M; i++) {
+            rowFirst[f][i] += rowFirst[f][i - 1];
+        }
+        start = rowFirst[f][sim.M];
+    }
+
+    samples.assign(static_cast<std::size_t>(slots) * columns.size(), 0.0f);
+    times.assign(slots, 0.0);
+    stale = false;
+}
+
+template <typename S, typename C>
+int BasicProbeSet<S, C>::reserve(int steps) {
+    if (empty()) {
+        return steps;
+    }
+    if (stale) {
+        rebuild();
+    }
+    steps = std::min(steps, slots);
+    if (count + steps > slots && fd >= 0) {
+        writeBlock();
+    }
+    if (count + steps > slots) {
+        const int dropped = count + steps - slots;
+        head = (head + dropped) % slots;
+        count -= dropped;
+    }
+    return steps;
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::commit(int steps, double startTime) {
+    stepsDone += steps;
+    if (empty()) {
+        return;
+    }
+    // Each sample is taken at the end of its step.
+    const std::vector<double> stepTimes = sim.stepTimes(startTime, steps);
+    for (int level = 0; level < steps; level++) {
+        times[slot(count + level)] = stepTimes[level + 1];
+    }
+    count += steps;
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::gather(FieldComponent field, int level, int rowBegin, int rowEnd) {
+    const std::vector<int> &first = rowFirst[static_cast<int>(field)];
+    const int begin = first[rowBegin], end = first[rowEnd];
+    if (begin == end) {
+        return;
+    }
+    const S *values = sim.field(field).origin();
+    float *out = &samples[static_cast<std::size_t>(slot(count + level)) * columns.size()];
+    for (int k = begin; k < end; k++) {
+        out[targets[k]] = float(values[offsets[k]]);
+    }
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::sampleElectricRows(int level, int rowBegin, int rowEnd) {
+    if (empty() || rowBegin >= rowEnd) {
+        return;
+    }
+    gather(FieldComponent::Ez, level, rowBegin == 1 ? 0 : rowBegin, rowEnd == sim.M - 1 ? sim.M : rowEnd);
+}
+
+template <typename S, typename C>
+void BasicProbeSet<S, C>::sampleMagneticRows(int level, int rowBegin, int rowEnd) {
+    if (empty()) {
+        return;
+    }
+    gather(FieldComponent::Hx, level, rowBegin, rowEnd);
+    gather(FieldComponent::Hy, level, rowBegin, rowEnd);
+}
+
+template <typename S, typename C>
+bool BasicProbeSet<S, C>::openOutput(const std::string &path, std::string &error, bool append, long keepUntil) {
+    if (!closeOutput(error)) {
+        return false;
+    }
+
+    std::vector<char> header(sizeof(FileHeader) + columns.size() * sizeof(ColumnRecord), 0);
+    FileHeader file{};
+    std::memcpy(file.magic, kFileMagic, sizeof(kFileMagic));
+    file.version = kProbeVersion;
+    file.columnCount = static_cast<std::uint32_t>(columns.size());
+    std::memcpy(header.data(), &file, sizeof(file));
+    for (std::size_t c = 0; c < columns.size(); c++) {
+        ColumnRecord record{};
+        std::strncpy(record.name, columns[c].name.c_str(), sizeof(record.name) - 1);
+        record.field = static_cast<std::uint32_t>(columns[c].field);
+        record.i = columns[c].i;
+        record.j = columns[c].j;
+        std::memcpy(&header[sizeof(file) + c * sizeof(record)], &record, sizeof(record));
+    }
+
+    int output = append ? ::open(path.c_str(), O_RDWR) : -1;
+    if (output >= 0) {
+        std::vector<char> existing(header.size());
+        if (!readAll(output, existing.data(), existing.size(), 0) || existing != header) {
+            error = path + " holds other probes";
+            ::close(output);
+            return false;
+        }
+        // Keep whole blocks up to keepUntil.
+        const std::uint64_t size = static_cast<std::uint64_t>(::lseek(output, 0, SEEK_END));
+        std::uint64_t end = header.size();
+        BlockHeader block;
+        while (readAll(output, &block, sizeof(block), end) &&
+            std::memcmp(block.magic, kBlockMagic, sizeof(kBlockMagic)) == 0 &&
+            block.firstStep + block.sampleCount - 1 <= keepUntil) {
+            const std::uint64_t next = end + sizeof(block) + block.sampleCount * sizeof(double) +
+                std::uint64_t(block.sampleCount) * columns.size() * sizeof(float);
+            if (next > size) {
+                break;
+            }
+            end = next;
+        }
+        if (::ftruncate(output, static_cast<off_t>(end)) != 0) {
+            error = "cannot truncate " + path;
+            ::close(output);
+            return false;
+        }
+        writeOffset = end;
+    } else {
+        output = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output < 0 || !writeAll(output, header.data(), header.size(), 0)) {
+            error = "cannot create " + path;
+            if (output >= 0) {
+                ::close(output);
+            }
+            return false;
+        }
+        writeOffset = header.size();
+    }
+    fd = output;
+    outputError.clear();
+    return true;
+}
+
+// Transposes the ring into columns and appends it as one block.
+template <typename S, typename C>
+bool BasicProbeSet<S, C>::writeBlock() {
+    if (count == 0) {
+        return outputError.empty();
+    }
+    const std::size_t columnBytes = count * sizeof(float);
+    block.resize(sizeof(BlockHeader) + count * sizeof(double) + columns.size() * columnBytes);
+
+    BlockHeader header{};
+    std::memcpy(header.magic, kBlockMagic, sizeof(kBlockMagic));
+    header.sampleCount = static_cast<std::uint32_t>(count);
+    header.firstStep = sampleStep(0);
+    std::memcpy(block.data(), &header, sizeof(header));
+
+    double *blockTimes = reinterpret_cast<double*>(block.data() + sizeof(header));
+    float *blockSamples = reinterpret_cast<float*>(blockTimes + count);
+    for (int k = 0; k < count; k++) {
+        blockTimes[k] = sampleTime(k);
+        const float *row = &samples[static_cast<std::size_t>(slot(k)) * columns.size()];
+        for (std::size_t c = 0; c < columns.size(); c++) {
+            blockSamples[c * count + k] = row[c];
+        }
+    }
+    discard();
+
+    if (outputError.empty() && !writeAll(fd, block.data(), block.size(), writeOffset)) {
+        outputError = "cannot write probe samples";
+    }
+    writeOffset += block.size();
+    return outputError.empty();
+}
+
+template <typename S, typename C>
+bool BasicProbeSet<S, C>::flush(std::string &error) {
+    if (fd < 0) {
+        return true;
+    }
+    if (!writeBlock()) {
+        error = outputError;
+        return false;
+    }
+    return true;
+}
+
+template <typename S, typename C>
+bool BasicProbeSet<S, C>::closeOutput(std::string &error) {
+    if (fd < 0) {
+        return true;
+    }
+    bool ok = flush(error);
+    if (::close(fd) != 0 && ok) {
+        error = "cannot close probe output";
+        ok = false;
+    }
+    fd = -1;
+    return ok;
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicProbeSet<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
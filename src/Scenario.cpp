@@ -0,0 +1,400 @@
+#include <fstream>
+#include <sstream>
+
+#include "Colormap.hpp"
+#include "Scenario.hpp"
+#include "FieldComponent.hpp"
+#include "Sources.hpp"
+#include "Tfsf.hpp"
+
+
+// Reads exactly the given values from the rest of the line.
+template <typename... Values>
+static bool readValues(std::istringstream &in, Values&... values) {
+    (in >> ... >> values);
+    std::string extra;
+    return !in.fail() && !(in >> extra);
+}
+
+static bool parseMaterial(std::istringstream &in, Scenario &scenario, std::string &error) {
+    ScenarioMaterial material;
+    if (!(in >> material.name)) {
+        error = "material needs a name";
+        return false;
+    }
+    std::string key;
+    while (in >> key) {
+        double value;
+        if (!(in >> value)) {
+            error = "material " + material.name + ": missing value for " + key;
+            return false;
+        }
+        if (key == "epsr") {
+            material.epsr = value;
+        } else if (key == "mur") {
+            material.mur = value;
+        } else if (key == "loss") {
+            material.loss = value;
+        } else if (key == "magnetic_loss") {
+            material.magneticLoss = value;
+        } else {
+            error = "material " + material.name + ": unknown property " + key;
+            return false;
+        }
+    }
+    scenario.materials.push_back(material);
+    return true;
+}
+
+static bool parseDispersion(std::istringstream &in, Scenario &scenario, std::string &error) {
+    ScenarioPole pole;
+    if (!(in >> pole.material >> pole.kind)) {
+        error = "dispersion needs a material and a pole kind";
+        return false;
+    }
+    bool ok;
+    if (pole.kind == "drude") {
+        ok = readValues(in, pole.frequency, pole.damping);
+    } else if (pole.kind == "lorentz") {
+        ok = readValues(in, pole.deltaEpsilon, pole.frequency, pole.damping);
+    } else if (pole.kind == "debye") {
+        ok = readValues(in, pole.deltaEpsilon, pole.relaxationTime);
+    } else {
+        error = "unknown pole kind " + pole.kind;
+        return false;
+    }
+    if (!ok) {
+        error = "dispersion " + pole.material + ": wrong values for a " + pole.kind + " pole";
+        return false;
+    }
+    scenario.poles.push_back(pole);
+    return true;
+}
+
+static bool parseWaveform(std::istringstream &in, Scenario &scenario, std::string &error) {
+    ScenarioWaveform waveform;
+    if (!(in >> waveform.name >> waveform.shape)) {
+        error = "waveform needs a name and a shape";
+        return false;
+    }
+    std::string key;
+    while (in >> key) {
+        bool ok;
+        if (key == "file") {
+            ok = static_cast<bool>(in >> waveform.file);
+        } else if (key == "frequency" || key == "delay" || key == "width" || key == "amplitude" || key == "interval") {
+            double &value = key == "frequency" ? waveform.frequency : key == "delay" ? waveform.delay :
+                key == "width" ? waveform.width : key == "amplitude" ? waveform.amplitude : waveform.interval;
+            ok = static_cast<bool>(in >> value);
+        } else {
+            error = "waveform " + waveform.name + ": unknown property " + key;
+            return false;
+        }
+        if (!ok) {
+            error = "waveform " + waveform.name + ": missing value for " + key;
+            return false;
+        }
+    }
+    scenario.waveforms.push_back(waveform);
+    return true;
+}
+
+static bool parseSource(const std::string &kind, std::istringstream &in, Scenario &scenario, std::string &error) {
+    ScenarioSource source;
+    source.kind = kind;
+    bool ok = static_cast<bool>(in >> source.waveform >> source.i0 >> source.j0);
+    if (ok && kind != "point") {
+        ok = static_cast<bool>(in >> source.i1 >> source.j1);
+    }
+    std::string key;
+    while (ok && in >> key) {
+        if (key == "hard" || key == "soft") {
+            source.hard = key == "hard";
+        } else if (key == "amplitude") {
+            ok = static_cast<bool>(in >> source.amplitude);
+        } else if (key == "delay") {
+            ok = static_cast<bool>(in >> source.delay);
+        } else {
+            error = "source_" + kind + ": unknown option " + key;
+            return false;
+        }
+    }
+    if (!ok) {
+        error = "malformed source_" + kind + " directive";
+        return false;
+    }
+    scenario.sources.push_back(source);
+    return true;
+}
+
+bool parseScenarioLine(const std::string &line, Scenario &scenario, std::string &error) {
+    std::istringstream in(line.substr(0, line.find('#')));
+    std::string key;
+    if (!(in >> key)) {
+        return true;
+    }
+
+    bool ok;
+    if (key == "grid") {
+        ok = readValues(in, scenario.M, scenario.N);
+    } else if (key == "spacing") {
+        ok = readValues(in, scenario.deltaX, scenario.deltaY);
+    } else if (key == "timestep") {
+        ok = readValues(in, scenario.deltaT);
+    } else if (key == "precision") {
+        ok = readValues(in, scenario.precision);
+    } else if (key == "backend") {
+        ok = readValues(in, scenario.backend);
+    } else if (key == "threads") {
+        ok = readValues(in, scenario.threads);
+    } else if (key == "tiling") {
+        ok = readValues(in, scenario.tiling);
+    } else if (key == "pml") {
+        ok = readValues(in, scenario.pml);
+    } else if (key == "steps") {
+        ok = readValues(in, scenario.steps);
+    } else if (key == "source") {
+        std::string first, extra;
+        ok = static_cast<bool>(in >> first);
+        scenario.pointSource = first != "none";
+        if (ok && scenario.pointSource) {
+            std::istringstream row(first);
+            ok = static_cast<bool>(row >> scenario.sourceRow) && readValues(in, scenario.sourceColumn);
+        } else {
+            ok = ok && !(in >> extra);
+        }
+    } else if (key == "plane_wave") {
+        ScenarioPlaneWave &wave = scenario.planeWave;
+        ok = static_cast<bool>(in >> wave.i0 >> wave.j0 >> wave.i1 >> wave.j1);
+        std::string extra;
+        wave.direction = "+i";
+        if (ok && in >> wave.direction) {
+            ok = !(in >> extra);
+        }
+    } else if (key == "material") {
+        return parseMaterial(in, scenario, error);
+    } else if (key == "dispersion") {
+        return parseDispersion(in, scenario, error);
+    } else if (key == "waveform") {
+        return parseWaveform(in, scenario, error);
+    } else if (key == "source_point" || key == "source_line" || key == "source_area") {
+        return parseSource(key.substr(7), in, scenario, error);
+    } else if (key == "region" || key == "conductor") {
+        ScenarioRegion region;
+        ok = key == "region" ? readValues(in, region.material, region.i0, region.j0, region.i1, region.j1)
+                             : readValues(in, region.i0, region.j0, region.i1, region.j1);
+        scenario.regions.push_back(region);
+    } else if (key == "probe" || key == "probe_line") {
+        ScenarioProbe probe;
+        ok = static_cast<bool>(in >> probe.name >> probe.i >> probe.j);
+        if (ok && key == "probe_line") {
+            ok = static_cast<bool>(in >> probe.i1 >> probe.j1);
+        }
+        std::string extra;
+        if (ok && in >> probe.field) {
+            ok = !(in >> extra);
+        }
+        scenario.probes.push_back(probe);
+    } else if (key == "dft") {
+        ScenarioDft dft;
+        ok = static_cast<bool>(in >> dft.name >> dft.field >> dft.i0 >> dft.j0 >> dft.i1 >> dft.j1);
+        double frequency;
+        while (ok && in >> frequency) {
+            dft.frequencies.push_back(frequency);
+        }
+        ok = ok && in.eof() && !dft.frequencies.empty();
+        scenario.dfts.push_back(dft);
+    } else if (key == "probe_interval") {
+        ok = readValues(in, scenario.probeInterval);
+    } else if (key == "probe_format") {
+        ok = readValues(in, scenario.probeFormat);
+    } else if (key == "snapshot_interval") {
+        ok = readValues(in, scenario.snapshotInterval);
+    } else if (key == "snapshot_format") {
+        ok = readValues(in, scenario.snapshotFormat);
+    } else if (key == "snapshot_fields") {
+        scenario.snapshotFields.clear();
+        std::string name;
+        while (in >> name) {
+            scenario.snapshotFields.push_back(name);
+        }
+        ok = !scenario.snapshotFields.empty();
+    } else if (key == "image_interval") {
+        ok = readValues(in, scenario.imageInterval);
+    } else if (key == "colormap") {
+        ok = readValues(in, scenario.colormap);
+    } else if (key == "color_range") {
+        ok = static_cast<bool>(in >> scenario.colorRange);
+        if (ok && scenario.colorRange == "fixed") {
+            ok = readValues(in, scenario.colorLow, scenario.colorHigh);
+        } else if (ok) {
+            std::string extra;
+            ok = (scenario.colorRange == "symmetric" || scenario.colorRange == "auto") && !(in >> extra);
+        }
+    } else if (key == "checkpoint_interval") {
+        ok = readValues(in, scenario.checkpointInterval);
+    } else if (key == "checkpoint") {
+        ok = readValues(in, scenario.checkpoint);
+    } else if (key == "restart") {
+        ok = readValues(in, scenario.restart);
+    } else if (key == "output") {
+        ok = readValues(in, scenario.output);
+    } else {
+        error = "unknown directive " + key;
+        return false;
+    }
+
+    if (!ok) {
+        error = "malformed " + key + " directive";
+    }
+    return ok;
+}
+
+bool loadScenario(const std::string &path, Scenario &scenario, std::string &error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        if (!parseScenarioLine(line, scenario, error)) {
+            error = path + ":" + std::to_string(number) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool validateScenario(const Scenario &scenario, std::string &error) {
+    auto inside = [&](int i, int j) { return 0 <= i && i < scenario.M && 0 <= j && j < scenario.N; };
+    // Sources drive E_z, which stays zero on the outer ring.
+    auto drivable = [&](int i, int j) { return 0 < i && i < scenario.M - 1 && 0 < j && j < scenario.N - 1; };
+
+    if (scenario.M < 3 || scenario.N < 3) {
+        error = "grid must be at least 3 x 3";
+        return false;
+    }
+    if (scenario.steps < 0 || scenario.probeInterval < 1 || scenario.snapshotInterval < 0 ||
+        scenario.imageInterval < 0 || scenario.checkpointInterval < 0) {
+        error = "steps and intervals must not be negative";
+        return false;
+    }
+    if (scenario.checkpointInterval > 0 && scenario.checkpoint.empty() && scenario.output.empty()) {
+        error = "checkpoint_interval needs a checkpoint path or an output directory";
+        return false;
+    }
+    if (scenario.sourceRow >= 0 && !drivable(scenario.sourceRow, scenario.sourceColumn)) {
+        error = "source outside the grid interior";
+        return false;
+    }
+    for (const ScenarioWaveform &waveform: scenario.waveforms) {
+        SourceWaveform::Shape shape;
+        if (!parseWaveformShape(waveform.shape, shape)) {
+            error = "waveform " + waveform.name + ": unknown shape " + waveform.shape;
+            return false;
+        }
+        if ((shape == SourceWaveform::Shape::Sampled) != !waveform.file.empty()) {
+            error = "waveform " + waveform.name + ": a file goes with, and only with, shape sampled";
+            return false;
+        }
+        if (waveform.width <= 0.0 || waveform.interval <= 0.0) {
+            error = "waveform " + waveform.name + ": width and interval must be positive";
+            return false;
+        }
+    }
+    for (const ScenarioSource &source: scenario.sources) {
+        bool found = false;
+        for (const ScenarioWaveform &waveform: scenario.waveforms) {
+            found = found || waveform.name == source.waveform;
+        }
+        if (!found) {
+            error = "source uses undefined waveform " + source.waveform;
+            return false;
+        }
+        const bool area = source.kind == "area";
+        if (!drivable(source.i0, source.j0) || (source.kind == "line" && !drivable(source.i1, source.j1)) ||
+            (area && (source.i1 > scenario.M - 1 || source.j1 > scenario.N - 1 || source.i0 >= source.i1 ||
+                source.j0 >= source.j1))) {
+            error = "source_" + source.kind + " of " + source.waveform + " is empty or outside the grid interior";
+            return false;
+        }
+    }
+    const ScenarioPlaneWave &wave = scenario.planeWave;
+    TfsfDirection direction;
+    if (!parseTfsfDirection(wave.direction, direction)) {
+        error = "unknown plane wave direction " + wave.direction;
+        return false;
+    }
+    if (!MaskRect{wave.i0, wave.j0, wave.i1, wave.j1}.empty() &&
+        !BasicTfsf<float, float>::fits(scenario.M, scenario.N, scenario.pml, {wave.i0, wave.j0, wave.i1, wave.j1})) {
+        error = "plane wave region must stay " + std::to_string(scenario.pml + 2) + " cells from the edges";
+        return false;
+    }
+    for (const ScenarioRegion &region: scenario.regions) {
+        if (region.material.empty()) {
+            continue;
+        }
+        bool found = false;
+        for (const ScenarioMaterial &material: scenario.materials) {
+            found = found || material.name == region.material;
+        }
+        if (!found) {
+            error = "region uses undefined material " + region.material;
+            return false;
+        }
+    }
+    for (const ScenarioPole &pole: scenario.poles) {
+        bool found = false;
+        for (const ScenarioMaterial &material: scenario.materials) {
+            found = found || material.name == pole.material;
+        }
+        if (!found) {
+            error = "dispersion of undefined material " + pole.material;
+            return false;
+        }
+    }
+    if (scenario.snapshotFormat != "raw" && scenario.snapshotFormat != "chunked") {
+        error = "unknown snapshot format " + scenario.snapshotFormat;
+        return false;
+    }
+    for (const std::string &name: scenario.snapshotFields) {
+        FieldComponent field;
+        if (!parseFieldComponent(name, field)) {
+            error = "unknown snapshot field " + name;
+            return false;
+        }
+    }
+    if (!Colormap::find(scenario.colormap)) {
+        error = "unknown colormap " + scenario.colormap;
+        return false;
+    }
+    if (scenario.probeFormat != "csv" && scenario.probeFormat != "columnar") {
+        error = "unknown probe format " + scenario.probeFormat;
+        return false;
+    }
+    for (const ScenarioProbe &probe: scenario.probes) {
+        FieldComponent field;
+        if (!parseFieldComponent(probe.field, field)) {
+            error = "probe " + probe.name + ": unknown field " + probe.field;
+            return false;
+        }
+        if (!inside(probe.i, probe.j) || (probe.i1 >= 0 && !inside(probe.i1, probe.j1))) {
+            error = "probe " + probe.name + " outside the grid";
+            return false;
+        }
+    }
+    for (const ScenarioDft &dft: scenario.dfts) {
+        FieldComponent field;
+        if (!parseFieldComponent(dft.field, field)) {
+            error = "dft " + dft.name + ": unknown field " + dft.field;
+            return false;
+        }
+        if (dft.i0 < 0 || dft.j0 < 0 || dft.i1 > scenario.M || dft.j1 > scenario.N || dft.i0 >= dft.i1 ||
+            dft.j0 >= dft.j1) {
+            error = "dft " + dft.name + " region is empty or outside the grid";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <numbers>
+#include <unistd.h>
+
+#include "Simulation3D.hpp"
+
+// As in Simulation.cpp: spans shorter than this are not worth a separate
+// kernel call.
+static const int minSpanLength = 16;
+
+
+template <typename S, typename C>
+BasicSimulation3D<S, C>::BasicSimulation3D(int l, int m, int n, C deltaX, C deltaT, int threads, int firstCpu)
+    : deltaX(deltaX), deltaT(deltaT), L(l), M(m), N(n), sourcePlane(l/2), sourceRow(m/2), sourceColumn(n/2),
+        material(l, m, n), E_x(l, m, n), E_y(l, m, n), E_z(l, m, n), H_x(l, m, n), H_y(l, m, n), H_z(l, m, n),
+        pool(threads, firstCpu), kernels(&selectKernels<S, C>()), spans(l), spanFirst(l, std::vector<int>(m + 1, 0)),
+        planeIsDirty(l, 1) {
+    materials.assign(1, compileMaterial(MaterialProperties{}, Cdtds, imp0));
+
+    // Each worker clears the planes it owns in the slab decomposition,
+    // the first and the last one the ghost planes next to theirs.
+    pool.run([&](int worker) {
+        int lo, hi;
+        ThreadPool::partition(0, L, worker, pool.size(), lo, hi);
+        if (lo >= hi) {
+            return;
+        }
+        lo = lo == 0 ? -1 : lo;
+        hi = hi == L ? L + 1 : hi;
+        material.fillPlanes(lo, hi, 0);
+        for (Linear3DVector<S> *field: {&E_x, &E_y, &E_z, &H_x, &H_y, &H_z}) {
+            field->fillPlanes(lo, hi, S(0.0f));
+        }
+    });
+}
+
+template <typename S, typename C>
+int BasicSimulation3D<S, C>::addMaterial(const MaterialProperties &properties) {
+    if (static_cast<int>(materials.size()) >= kMaxMaterials) {
+        return -1;
+    }
+    materials.push_back(compileMaterial(properties, Cdtds, imp0));
+    return static_cast<int>(materials.size()) - 1;
+}
+
+template <typename S, typename C>
+bool BasicSimulation3D<S, C>::setMaterial(int id, const MaterialProperties &properties) {
+    if (id < 0 || id >= static_cast<int>(materials.size())) {
+        return false;
+    }
+    materials[id] = compileMaterial(properties, Cdtds, imp0);
+    return true;
+}
+
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::fillMaterial(const GridBox &box, int id) {
+    if (id < 0 || id >= static_cast<int>(materials.size())) {
+        return;
+    }
+    const GridBox clipped{std::max(box.i0, 0), std::max(box.j0, 0), std::max(box.k0, 0),
+        std::min(box.i1, L), std::min(box.j1, M), std::min(box.k1, N)};
+    if (clipped.empty()) {
+        return;
+    }
+    for (int i = clipped.i0; i < clipped.i1; i++) {
+        for (int j = clipped.j0; j < clipped.j1; j++) {
+            std::uint8_t *row = material.row(i, j);
+            std::fill(row + clipped.k0, row + clipped.k1, static_cast<std::uint8_t>(id));
+        }
+        planeIsDirty[i] = 1;
+    }
+    spansDirty = true;
+}
+
+template <typename S, typename C>
+C BasicSimulation3D<S, C>::rickertSource(C time, C location) const {
+    // same source as the 2D solver
+    double arg = std::numbers::pi * ((Cdtds * time - location) / 19.0);
+    arg *= arg;
+    return C((1.0 - 2.0 * arg) * std::exp(-arg));
+}
+
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::refreshSpans() {
+    if (!spansDirty) {
+        return;
+    }
+    pool.parallelFor(0, L, 1, [this](int planeBegin, int planeEnd) {
+        std::vector<RowSpan> row;
+        for (int i = planeBegin; i < planeEnd; i++) {
+            if (!planeIsDirty[i]) {
+                continue;
+            }
+            spans[i].clear();
+            for (int j = 0; j < M; j++) {
+                buildRowSpans(material.row(i, j), nullptr, N, minSpanLength, row);
+                spanFirst[i][j] = static_cast<int>(spans[i].size());
+                spans[i].insert(spans[i].end(), row.begin(), row.end());
+            }
+            spanFirst[i][M] = static_cast<int>(spans[i].size());
+            planeIsDirty[i] = 0;
+        }
+    });
+    spansDirty = false;
+}
+
+// Rows per cache block: the block's rows of all fields in two planes, the
+// one being updated and the one it reads behind it, should fit in L2.
+template <typename S, typename C>
+int BasicSimulation3D<S, C>::blockRows() const {
+    if (blockRowCount > 0) {
+        return blockRowCount;
+    }
+
+    long cacheBytes = 1 << 20;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (reported > 0) {
+        cacheBytes = reported;
+    }
+#endif
+    const long bytesPerRow = 6L * E_x.pitch() * sizeof(S) + material.pitch();
+    const int rows = static_cast<int>(cacheBytes / (2 * bytesPerRow));
+    return std::clamp(rows, 1, M);
+}
+
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::advance(int steps) {
+    if (steps <= 0) {
+        return;
+    }
+    refreshSpans();
+
+    // Source values and time accumulated the way the 2D solver does.
+    std::vector<C> source(steps);
+    for (int level = 0; level < steps; level++) {
+        source[level] = rickertSource(C(time), C(0));
+        time += deltaT;
+    }
+
+    const int rows = blockRows();
+    if (slabs) {
+        // One dispatch for all steps; workers keep their slab and meet at
+        // a barrier after each half-step.
+        pool.run([&](int worker) {
+            int lo, hi;
+            ThreadPool::partition(0, L, worker, pool.size(), lo, hi);
+            const int eLo = std::max(1, lo), eHi = std::min(L - 1, hi);
+
+            for (int level = 0; level < steps; level++) {
+                for (int j0 = 1; j0 < M - 1; j0 += rows) {
+                    const int j1 = std::min(M - 1, j0 + rows);
+                    for (int i = eLo; i < eHi; i++) {
+                        updateElectricRows(i, j0, j1);
+                    }
+                }
+                applySource(source[level], eLo, eHi, 1, M - 1);
+                pool.barrier();
+                for (int j0 = 0; j0 < M; j0 += rows) {
+                    const int j1 = std::min(M, j0 + rows);
+                    for (int i = lo; i < hi; i++) {
+                        updateMagneticRows(i, j0, j1);
+                    }
+                }
+                pool.barrier();
+            }
+        });
+        return;
+    }
+
+    // Blocks of rows through kPlanesPerChunk planes, to whichever worker
+    // is free.
+    const int rowBlocks = (M + rows - 1) / rows;
+    const int planeChunks = (L + kPlanesPerChunk - 1) / kPlanesPerChunk;
+    auto sweep = [&](bool electric, C value) {
+        pool.parallelFor(0, rowBlocks * planeChunks, 1, [&](int chunkBegin, int chunkEnd) {
+            for (int chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+                const int j0 = chunk / planeChunks * rows, j1 = std::min(M, j0 + rows);
+                const int p0 = chunk % planeChunks * kPlanesPerChunk, p1 = std::min(L, p0 + kPlanesPerChunk);
+                if (electric) {
+                    const int eLo = std::max(1, p0), eHi = std::min(L - 1, p1);
+                    for (int i = eLo; i < eHi; i++) {
+                        updateElectricRows(i, std::max(1, j0), std::min(M - 1, j1));
+                    }
+                    applySource(value, eLo, eHi, std::max(1, j0), std::min(M - 1, j1));
+                } else {
+                    for (int i = p0; i < p1; i++) {
+                        updateMagneticRows(i, j0, j1);
+                    }
+                }
+            }
+        });
+    };
+    for (int level = 0; level < steps; level++) {
+        sweep(true, source[level]);
+        sweep(false, C(0));
+    }
+}
+
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::applySource(C value, int planeBegin, int planeEnd, int rowBegin, int rowEnd) {
+    if (sourcePlane >= planeBegin && sourcePlane < planeEnd && sourceRow >= rowBegin && sourceRow < rowEnd) {
+        E_z.get(sourcePlane, sourceRow, sourceColumn) = S(value);
+    }
+}
+
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::updateRow(const CurlRow<S, C> &row, int i, int j, int columnBegin, int columnEnd,
+    bool electric) {
+    const RowSpan *span = spans[i].data() + spanFirst[i][j];
+    const RowSpan *last = spans[i].data() + spanFirst[i][j + 1];
+    for (; span != last; ++span) {
+        const int begin = std::max(span->begin, columnBegin);
+        const int end = std::min(span->end, columnEnd);
+        if (begin >= end) {
+            continue;
+        }
+        if (span->material >= 0) {
+            const MaterialCoefficients<C> &c = materials[span->material];
+            kernels->curlRowUniform(row, electric ? c.eze : c.hxh, electric ? c.ezh : c.hxe, begin, end);
+        } else {
+            kernels->curlRow(row, begin, end);
+        }
+    }
+}
+
+// Rows [rowBegin, rowEnd) of plane i of E, within [1, L-1) x [1, M-1).
+//   E_x += ezh ((H_z - H_z[j-1]) - (H_y - H_y[k-1]))
+//   E_y += ezh ((H_x - H_x[k-1]) - (H_z - H_z[i-1]))
+//   E_z += ezh ((H_y - H_y[i-1]) - (H_x - H_x[j-1]))
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::updateElectricRows(int i, int rowBegin, int rowEnd) {
+    const C *coefficients = &materials[0].eze;
+    for (int j = rowBegin; j < rowEnd; j++) {
+        const std::uint8_t *cells = material.row(i, j);
+        const S *hx = H_x.row(i, j), *hy = H_y.row(i, j), *hz = H_z.row(i, j);
+        updateRow({E_x.row(i, j), hz, H_z.row(i, j - 1), hy, hy - 1, cells, coefficients}, i, j, 1, N - 1, true);
+        updateRow({E_y.row(i, j), hx, hx - 1, hz, H_z.row(i - 1, j), cells, coefficients}, i, j, 1, N - 1, true);
+        updateRow({E_z.row(i, j), hy, H_y.row(i - 1, j), hx, H_x.row(i, j - 1), cells, coefficients}, i, j, 1, N - 1,
+            true);
+    }
+}
+
+// Rows [rowBegin, rowEnd) of plane i of H, within [0, L) x [0, M). The
+// differences are turned around so the kernels add them:
+//   H_x += hxe ((E_y[k+1] - E_y) - (E_z[j+1] - E_z))
+//   H_y += hxe ((E_z[i+1] - E_z) - (E_x[k+1] - E_x))
+//   H_z += hxe ((E_x[j+1] - E_x) - (E_y[i+1] - E_y))
+template <typename S, typename C>
+void BasicSimulation3D<S, C>::updateMagneticRows(int i, int rowBegin, int rowEnd) {
+    const C *coefficients = &materials[0].hxh;
+    for (int j = rowBegin; j < rowEnd; j++) {
+        const std::uint8_t *cells = material.row(i, j);
+        const S *ex = E_x.row(i, j), *ey = E_y.row(i, j), *ez = E_z.row(i, j);
+        updateRow({H_x.row(i, j), ey + 1, ey, E_z.row(i, j + 1), ez, cells, coefficients}, i, j, 0, N, false);
+        updateRow({H_y.row(i, j), E_z.row(i + 1, j), ez, ex + 1, ex, cells, coefficients}, i, j, 0, N, false);
+        updateRow({H_z.row(i, j), E_x.row(i, j + 1), ex, E_y.row(i + 1, j), ey, cells, coefficients}, i, j, 0, N,
+            false);
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicSimulation3D<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "SimulationRunner.hpp"
+
+
+template <typename S, typename C>
+BasicSimulationRunner<S, C>::BasicSimulationRunner(Simulation &sim)
+    : sim(sim), frames(FieldFrame(sim.M, sim.N)) {}
+
+template <typename S, typename C>
+BasicSimulationRunner<S, C>::~BasicSimulationRunner() {
+    stop();
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::start() {
+    if (worker.joinable()) {
+        return;
+    }
+    stopping = false;
+    publish();
+    frames.refresh();
+    worker = std::thread(&BasicSimulationRunner::loop, this);
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::setPaused(bool paused) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isPaused.store(paused);
+    }
+    wake.notify_all();
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::post(const SimulationEdit &edit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        edits.push_back(edit);
+    }
+    wake.notify_all();
+}
+
+template <typename S, typename C>
+bool BasicSimulationRunner<S, C>::finished() const {
+    double endTime = end.load();
+    return endTime > 0.0 && sim.time >= endTime;
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::loop() {
+    using Clock = std::chrono::steady_clock;
+    int batch = 1;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] {
+                return stopping || !edits.empty() || (!isPaused.load() && !finished());
+            });
+            if (stopping) {
+                return;
+            }
+        }
+
+        applyEdits();
+        if (isPaused.load() || finished()) {
+            // Show the edits even though no steps are taken.
+            publish();
+            continue;
+        }
+
+        // Do not run past the end time.
+        int steps = batch;
+        if (end.load() > 0.0) {
+            steps = std::clamp(static_cast<int>(std::ceil((end.load() - sim.time) / sim.deltaT)), 1, batch);
+        }
+
+        auto start = Clock::now();
+        sim.advance(steps);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        stepCount.fetch_add(steps);
+        rate.store(steps / std::max(seconds, 1e-9));
+
+        publish();
+
+        // Aim for one batch per display frame.
+        if (steps < batch) {
+            continue;
+        }
+        double scale = std::clamp(frameInterval / std::max(seconds, 1e-6), 0.5, 2.0);
+        batch = std::clamp(static_cast<int>(batch * scale), 1, 4096);
+    }
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::applyEdits() {
+    std::vector<SimulationEdit> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(edits);
+    }
+    for (const SimulationEdit &edit: pending) {
+        const bool conductor = edit.kind == SimulationEdit::AddConductor;
+        if (edit.shape == SimulationEdit::Stroke) {
+            sim.strokeConductors({double(edit.i0), double(edit.j0)}, {double(edit.i1), double(edit.j1)},
+                edit.radius, conductor);
+        } else {
+            sim.fillConductors({edit.i0, edit.j0, edit.i1, edit.j1}, conductor);
+        }
+    }
+}
+
+template <typename S, typename C>
+void BasicSimulationRunner<S, C>::publish() {
+    FieldFrame &frame = frames.back();
+    const S *field = sim.electricField();
+    const int pitch = sim.E_z.pitch();
+    for (int i = 0; i < sim.M; i++) {
+        const S *values = field + static_cast<size_t>(i) * pitch;
+        float *out = frame.ez.row(i);
+        for (int j = 0; j < sim.N; j++) {
+            out[j] = float(values[j]);
+        }
+    }
+    frame.conductor.assign(sim.conductors);
+    frame.step = stepCount.load();
+    frame.time = sim.time;
+    frames.publish();
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicSimulationRunner<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileIO.hpp"
+#include "Simulation.hpp"
+#include "SnapshotFile.hpp"
+
+static const char kFileMagic[8] = {'E', 'M', 'S', 'I', 'M', 'S', 'N', 'P'};
+static const char kFrameMagic[4] = {'F', 'R', 'M', 'E'};
+constexpr std::uint32_t kSnapshotVersion = 1;
+
+enum ChunkCodec : std::uint32_t {
+    kRaw = 0,
+    kShuffledRuns = 1,
+};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t fields;
+    std::int32_t M, N, tile;
+    std::uint32_t reserved;
+};
+
+struct FrameHeader {
+    char magic[4];
+    std::uint32_t chunkCount;
+    std::int64_t step;
+    double time;
+    std::uint64_t bytes;  // header, chunk table and data
+};
+
+struct ChunkEntry {
+    std::uint32_t codec;
+    std::uint32_t bytes;
+};
+
+static int tilesAlong(int cells) {
+    return (cells + kSnapshotTile - 1) / kSnapshotTile;
+}
+
+static int fieldCount(unsigned fields) {
+    int count = 0;
+    for (int f = 0; f < kFieldComponentCount; f++) {
+        count += (fields >> f) & 1;
+    }
+    return count;
+}
+
+static std::uint64_t fileSize(int fd) {
+    struct stat status;
+    return ::fstat(fd, &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+}
+
+static bool readFileHeader(int fd, const std::string &path, FileHeader &header, std::string &error) {
+    if (!readAll(fd, &header, sizeof(header), 0) || std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0) {
+        error = path + " is not a snapshot file";
+        return false;
+    }
+    if (header.version != kSnapshotVersion || header.tile != kSnapshotTile) {
+        error = path + ": unsupported snapshot version " + std::to_string(header.version);
+        return false;
+    }
+    return true;
+}
+
+// True if a whole frame starts at offset.
+static bool readFrameHeader(int fd, std::uint64_t offset, std::uint64_t size, const FileHeader &file,
+    FrameHeader &frame) {
+    const std::uint64_t chunks =
+        static_cast<std::uint64_t>(fieldCount(file.fields)) * tilesAlong(file.M) * tilesAlong(file.N);
+    return offset + sizeof(frame) <= size && readAll(fd, &frame, sizeof(frame), offset) &&
+        std::memcmp(frame.magic, kFrameMagic, sizeof(kFrameMagic)) == 0 && frame.chunkCount == chunks &&
+        frame.bytes >= sizeof(frame) + chunks * sizeof(ChunkEntry) && offset + frame.bytes <= size;
+}
+
+// PackBits-style coding: a control byte c < 128 is followed by c + 1
+// literal bytes, c >= 128 by one byte repeated c - 125 times.
+static void packRuns(const std::uint8_t *in, std::size_t n, std::vector<std::uint8_t> &out) {
+    std::size_t k = 0;
+    while (k < n) {
+        std::size_t run = 1;
+        while (k + run < n && run < 130 && in[k + run] == in[k]) {
+            run++;
+        }
+        if (run >= 3) {
+            out.push_back(static_cast<std::uint8_t>(run + 125));
+            out.push_back(in[k]);
+            k += run;
+            continue;
+        }
+        const std::size_t start = k;
+        while (k < n && k - start < 128 && !(k + 2 < n && in[k] == in[k + 1] && in[k] == in[k + 2])) {
+            k++;
+        }
+        out.push_back(static_cast<std::uint8_t>(k - start - 1));
+        out.insert(out.end(), in + start, in + k);
+    }
+}
+
+static bool unpackRuns(const std::uint8_t *in, std::size_t n, std::uint8_t *out, std::size_t expected) {
+    std::size_t p = 0, q = 0;
+    while (p < n) {
+        const std::uint8_t c = in[p++];
+        if (c < 128) {
+            const std::size_t length = c + 1;
+            if (p + length > n || q + length > expected) {
+                return false;
+            }
+            std::memcpy(out + q, in + p, length);
+            p += length;
+            q += length;
+        } else {
+            const std::size_t length = c - 125;
+            if (p >= n || q + length > expected) {
+                return false;
+            }
+            std::memset(out + q, in[p++], length);
+            q += length;
+        }
+    }
+    return q == expected;
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    std::string ignored;
+    close(ignored);
+}
+
+bool SnapshotWriter::open(const std::string &path, int m, int n, unsigned fields, std::string &error, bool append,
+    long keepUntil) {
+    if (isOpen() && !close(error)) {
+        return false;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+    header.version = kSnapshotVersion;
+    header.fields = fields;
+    header.M = m;
+    header.N = n;
+    header.tile = kSnapshotTile;
+
+    int file = append ? ::open(path.c_str(), O_RDWR) : -1;
+    if (file >= 0) {
+        FileHeader existing;
+        if (!readFileHeader(file, path, existing, error)) {
+            ::close(file);
+            return false;
+        }
+        if (existing.M != m || existing.N != n || existing.fields != fields) {
+            error = path + " holds other fields or another grid";
+            ::close(file);
+            return false;
+        }
+        // Keep the frames up to keepUntil and cut the rest.
+        const std::uint64_t size = fileSize(file);
+        std::uint64_t end = sizeof(header);
+        FrameHeader frame;
+        while (readFrameHeader(file, end, size, existing, frame) && frame.step <= keepUntil) {
+            end += frame.bytes;
+        }
+        if (::ftruncate(file, static_cast<off_t>(end)) != 0) {
+            error = "cannot truncate " + path;
+            ::close(file);
+            return false;
+        }
+        writeOffset = end;
+    } else {
+        file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0 || !writeAll(file, &header, sizeof(header), 0)) {
+            error = "cannot create " + path;
+            if (file >= 0) {
+                ::close(file);
+            }
+            return false;
+        }
+        writeOffset = sizeof(header);
+    }
+
+    fd = file;
+    M = m;
+    N = n;
+    this->fields = fields;
+    for (Frame &frame: frames) {
+        for (int f = 0; f < kFieldComponentCount; f++) {
+            frame.values[f].assign((fields >> f) & 1 ? static_cast<std::size_t>(M) * N : 0, 0.0f);
+        }
+    }
+    back = 0;
+    job = nullptr;
+    stopping = false;
+    firstError.clear();
+    worker = std::thread([this] { run(); });
+    return true;
+}
+
+template <typename S, typename C>
+void SnapshotWriter::capture(BasicSimulation<S, C> &sim, long step) {
+    if (!isOpen()) {
+        return;
+    }
+    sim.synchronize();
+    Frame &frame = frames[back];
+    frame.step = step;
+    frame.time = sim.time;
+    for (int f = 0; f < kFieldComponentCount; f++) {
+        if (!((fields >> f) & 1)) {
+            continue;
+        }
+        const Linear2DVector<S> &source = sim.field(static_cast<FieldComponent>(f));
+        float *out = frame.values[f].data();
+        for (int i = 0; i < M; i++) {
+            const S *row = source.row(i);
+            for (int j = 0; j < N; j++) {
+                out[static_cast<std::size_t>(i) * N + j] = float(row[j]);
+            }
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return job == nullptr; });
+        job = &frame;
+    }
+    wake.notify_one();
+    back ^= 1;
+}
+
+bool SnapshotWriter::close(std::string &error) {
+    if (!isOpen()) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+
+    const bool closed = ::close(fd) == 0;
+    fd = -1;
+    if (!firstError.empty()) {
+        error = firstError;
+        return false;
+    }
+    if (!closed) {
+        error = "cannot close snapshot file";
+        return false;
+    }
+    return true;
+}
+
+void SnapshotWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&] { return job != nullptr || stopping; });
+        if (!job) {
+            return;
+        }
+        const Frame *frame = job;
+        lock.unlock();
+        writeFrame(*frame);
+        lock.lock();
+        job = nullptr;
+        done.notify_all();
+    }
+}
+
+void SnapshotWriter::writeFrame(const Frame &frame) {
+    if (!firstError.empty()) {
+        return;
+    }
+
+    const int tileRows = tilesAlong(M), tileCols = tilesAlong(N);
+    std::vector<ChunkEntry> table;
+    packed.clear();
+    for (int f = 0; f < kFieldComponentCount; f++) {
+        if (!((fields >> f) & 1)) {
+            continue;
+        }
+        const float *values = frame.values[f].data();
+        for (int ti = 0; ti < tileRows; ti++) {
+            for (int tj = 0; tj < tileCols; tj++) {
+                const int i0 = ti * kSnapshotTile, i1 = std::min(M, i0 + kSnapshotTile);
+                const int j0 = tj * kSnapshotTile, j1 = std::min(N, j0 + kSnapshotTile);
+                const std::size_t count = static_cast<std::size_t>(i1 - i0) * (j1 - j0);
+
+                shuffled.resize(count * sizeof(float));
+                std::size_t k = 0;
+                for (int i = i0; i < i1; i++) {
+                    for (int j = j0; j < j1; j++, k++) {
+                        std::uint32_t bits;
+                        std::memcpy(&bits, &values[static_cast<std::size_t>(i) * N + j], sizeof(bits));
+                        for (std::size_t b = 0; b < sizeof(bits); b++) {
+                            shuffled[b * count + k] = static_cast<std::uint8_t>(bits >> (8 * b));
+                        }
+                    }
+                }
+
+                const std::size_t before = packed.size();
+                packRuns(shuffled.data(), shuffled.size(), packed);
+                ChunkEntry entry{kShuffledRuns, static_cast<std::uint32_t>(packed.size() - before)};
+                if (entry.bytes >= count * sizeof(float)) {
+                    packed.resize(before);
+                    for (int i = i0; i < i1; i++) {
+                        const auto *row = reinterpret_cast<const std::uint8_t*>(&values[static_cast<std::size_t>(i) * N + j0]);
+                        packed.insert(packed.end(), row, row + (j1 - j0) * sizeof(float));
+                    }
+                    entry = {kRaw, static_cast<std::uint32_t>(count * sizeof(float))};
+                }
+                table.push_back(entry);
+            }
+        }
+    }
+
+    FrameHeader header{};
+    std::memcpy(header.magic, kFrameMagic, sizeof(kFrameMagic));
+    header.chunkCount = static_cast<std::uint32_t>(table.size());
+    header.step = frame.step;
+    header.time = frame.time;
+    header.bytes = sizeof(header) + table.size() * sizeof(ChunkEntry) + packed.size();
+    const std::uint64_t tableOffset = writeOffset + sizeof(header);
+    const std::uint64_t packedOffset = tableOffset + table.size() * sizeof(ChunkEntry);
+    if (!writeAll(fd, &header, sizeof(header), writeOffset) ||
+        !writeAll(fd, table.data(), table.size() * sizeof(ChunkEntry), tableOffset) ||
+        !writeAll(fd, packed.data(), packed.size(), packedOffset)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        firstError = "cannot write snapshot frame " + std::to_string(frame.step);
+        return;
+    }
+    writeOffset += header.bytes;
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool SnapshotReader::open(const std::string &path, std::string &error) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    frames.clear();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    FileHeader header;
+    if (!readFileHeader(fd, path, header, error)) {
+        return false;
+    }
+    M = header.M;
+    N = header.N;
+    fields = header.fields;
+
+    const std::uint64_t size = fileSize(fd);
+    std::uint64_t offset = sizeof(header);
+    FrameHeader frame;
+    while (readFrameHeader(fd, offset, size, header, frame)) {
+        frames.push_back({static_cast<long>(frame.step), frame.time, offset});
+        offset += frame.bytes;
+    }
+    return true;
+}
+
+bool SnapshotReader::readWindow(int frame, FieldComponent field, const MaskRect &window, float *out, int outPitch,
+    std::string &error) {
+    if (frame < 0 || frame >= frameCount() || !hasField(field)) {
+        error = "no such frame or field";
+        return false;
+    }
+    const int i0 = std::max(window.i0, 0), i1 = std::min(window.i1, M);
+    const int j0 = std::max(window.j0, 0), j1 = std::min(window.j1, N);
+    if (i0 >= i1 || j0 >= j1) {
+        return true;
+    }
+
+    const int tileRows = tilesAlong(M), tileCols = tilesAlong(N);
+    const std::size_t chunkCount = static_cast<std::size_t>(fieldCount(fields)) * tileRows * tileCols;
+    std::vector<ChunkEntry> table(chunkCount);
+    const std::uint64_t tableOffset = frames[frame].offset + sizeof(FrameHeader);
+    if (!readAll(fd, table.data(), chunkCount * sizeof(ChunkEntry), tableOffset)) {
+        error = "cannot read frame " + std::to_string(frames[frame].step);
+        return false;
+    }
+
+    // Chunks of the fields stored before this one come first.
+    const int ordinal = fieldCount(fields & (snapshotFieldBit(field) - 1));
+    const std::size_t first = static_cast<std::size_t>(ordinal) * tileRows * tileCols;
+    std::uint64_t position = tableOffset + chunkCount * sizeof(ChunkEntry);
+    for (std::size_t c = 0; c < first; c++) {
+        position += table[c].bytes;
+    }
+
+    for (int ti = 0; ti < tileRows; ti++) {
+        for (int tj = 0; tj < tileCols; tj++) {
+            const ChunkEntry &entry = table[first + static_cast<std::size_t>(ti) * tileCols + tj];
+            const std::uint64_t chunkOffset = position;
+            position += entry.bytes;
+
+            const int ci0 = ti * kSnapshotTile, ci1 = std::min(M, ci0 + kSnapshotTile);
+            const int cj0 = tj * kSnapshotTile, cj1 = std::min(N, cj0 + kSnapshotTile);
+            if (ci1 <= i0 || ci0 >= i1 || cj1 <= j0 || cj0 >= j1) {
+                continue;
+            }
+            const int cols = cj1 - cj0;
+            const std::size_t count = static_cast<std::size_t>(ci1 - ci0) * cols;
+
+            packed.resize(entry.bytes);
+            bool ok = readAll(fd, packed.data(), entry.bytes, chunkOffset);
+            if (entry.codec == kRaw) {
+                ok = ok && entry.bytes == count * sizeof(float);
+                shuffled.swap(packed);
+            } else {
+                shuffled.resize(count * sizeof(float));
+                ok = ok && entry.codec == kShuffledRuns &&
+                    unpackRuns(packed.data(), packed.size(), shuffled.data(), shuffled.size());
+            }
+            if (!ok) {
+                error = "corrupt chunk in frame " + std::to_string(frames[frame].step);
+                return false;
+            }
+
+            for (int i = std::max(i0, ci0); i < std::min(i1, ci1); i++) {
+                float *row = out + static_cast<std::size_t>(i - i0) * outPitch;
+                for (int j = std::max(j0, cj0); j < std::min(j1, cj1); j++) {
+                    const std::size_t k = static_cast<std::size_t>(i - ci0) * cols + (j - cj0);
+                    std::uint32_t bits = 0;
+                    if (entry.codec == kRaw) {
+                        std::memcpy(&bits, &shuffled[k * sizeof(float)], sizeof(bits));
+                    } else {
+                        for (std::size_t b = 0; b < sizeof(bits); b++) {
+                            bits |= static_cast<std::uint32_t>(shuffled[b * count + k]) << (8 * b);
+                        }
+                    }
+                    std::memcpy(&row[j - j0], &bits, sizeof(bits));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#define EMSIM_INSTANTIATE(S, C) \
+    template void SnapshotWriter::capture<S, C>(BasicSimulation<S, C>&, long);
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
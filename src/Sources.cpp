@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <numbers>
+#include <sstream>
+
+#include "Simulation.hpp"
+#include "Sources.hpp"
+
+bool parseWaveformShape(const std::string &name, SourceWaveform::Shape &shape) {
+    static const char *const names[] = {"ricker", "gaussian", "modulated_sine", "sine", "sampled"};
+    for (int s = 0; s < 5; s++) {
+        if (name == names[s]) {
+            shape = static_cast<SourceWaveform::Shape>(s);
+            return true;
+        }
+    }
+    return false;
+}
+
+double waveformValue(const SourceWaveform &waveform, double time) {
+    using Shape = SourceWaveform::Shape;
+    const double t = time - waveform.delay;
+    const double envelope = std::exp(-(t / waveform.width) * (t / waveform.width));
+    double value = 0.0;
+    switch (waveform.shape) {
+    case Shape::Ricker: {
+        const double a = std::numbers::pi * waveform.frequency * t;
+        value = (1.0 - 2.0 * a * a) * std::exp(-a * a);
+        break;
+    }
+    case Shape::Gaussian:
+        value = envelope;
+        break;
+    case Shape::ModulatedSine:
+        value = std::sin(2.0 * std::numbers::pi * waveform.frequency * t) * envelope;
+        break;
+    case Shape::Sine:
+        if (t > 0.0) {
+            const double ramp = t < waveform.width ? 0.5 * (1.0 - std::cos(std::numbers::pi * t / waveform.width)) : 1.0;
+            value = ramp * std::sin(2.0 * std::numbers::pi * waveform.frequency * t);
+        }
+        break;
+    case Shape::Sampled: {
+        const double x = t / waveform.interval;
+        const double k = std::floor(x);
+        if (k >= 0.0 && k + 1.0 < static_cast<double>(waveform.samples.size())) {
+            const std::size_t n = static_cast<std::size_t>(k);
+            value = waveform.samples[n] + (x - k) * (waveform.samples[n + 1] - waveform.samples[n]);
+        } else if (k + 1.0 == static_cast<double>(waveform.samples.size())) {
+            value = waveform.samples.back();
+        }
+        break;
+    }
+    }
+    return waveform.amplitude * value;
+}
+
+bool loadWaveformSamples(const std::string &path, std::vector<double> &samples, std::string &error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    samples.clear();
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        std::istringstream in(line.substr(0, line.find('#')));
+        std::string token, extra;
+        if (!(in >> token)) {
+            continue;
+        }
+        char *end;
+        const double value = std::strtod(token.c_str(), &end);
+        if (*end != '\0' || in >> extra) {
+            error = path + ":" + std::to_string(number) + ": expected one number";
+            return false;
+        }
+        samples.push_back(value);
+    }
+    if (samples.empty()) {
+        error = path + " holds no samples";
+        return false;
+    }
+    return true;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::addWaveform(const SourceWaveform &waveform) {
+    waveforms.push_back(waveform);
+    return waveformCount() - 1;
+}
+
+// E_z cells the update writes; the outer ring is the PEC edge.
+static bool drivable(int i, int j, int m, int n) {
+    return 0 < i && i < m - 1 && 0 < j && j < n - 1;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::newSource(int waveform, double amplitude, double delay) {
+    if (waveform < 0 || waveform >= waveformCount()) {
+        return -1;
+    }
+    sources.push_back({waveform, amplitude, delay});
+    stale = true;
+    return sourceCount() - 1;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::addPoint(int waveform, int i, int j, SourceMode mode, double amplitude, double delay) {
+    if (!drivable(i, j, sim.M, sim.N)) {
+        return -1;
+    }
+    const int source = newSource(waveform, amplitude, delay);
+    if (source >= 0) {
+        registered.push_back({i, j, source, mode == SourceMode::Hard});
+    }
+    return source;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::addLine(int waveform, int i0, int j0, int i1, int j1, SourceMode mode, double amplitude,
+    double delay) {
+    if (!drivable(i0, j0, sim.M, sim.N) || !drivable(i1, j1, sim.M, sim.N)) {
+        return -1;
+    }
+    const int source = newSource(waveform, amplitude, delay);
+    if (source < 0) {
+        return -1;
+    }
+    // Same cells as BasicProbeSet::addLine().
+    const int count = std::max(std::abs(i1 - i0), std::abs(j1 - j0)) + 1;
+    for (int k = 0; k < count; k++) {
+        const double t = count > 1 ? double(k) / (count - 1) : 0.0;
+        const int i = static_cast<int>(std::lround(i0 + t * (i1 - i0)));
+        const int j = static_cast<int>(std::lround(j0 + t * (j1 - j0)));
+        registered.push_back({i, j, source, mode == SourceMode::Hard});
+    }
+    return source;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::addArea(int waveform, const MaskRect &rect, SourceMode mode, double amplitude,
+    double delay) {
+    if (rect.empty() || !drivable(rect.i0, rect.j0, sim.M, sim.N) ||
+        !drivable(rect.i1 - 1, rect.j1 - 1, sim.M, sim.N)) {
+        return -1;
+    }
+    const int source = newSource(waveform, amplitude, delay);
+    if (source < 0) {
+        return -1;
+    }
+    for (int i = rect.i0; i < rect.i1; i++) {
+        for (int j = rect.j0; j < rect.j1; j++) {
+            registered.push_back({i, j, source, mode == SourceMode::Hard});
+        }
+    }
+    return source;
+}
+
+template <typename S, typename C>
+void BasicSourceSet<S, C>::clear() {
+    waveforms.clear();
+    sources.clear();
+    registered.clear();
+    stale = true;
+}
+
+template <typename S, typename C>
+void BasicSourceSet<S, C>::rebuild() {
+    cells = registered;
+    builtInRow = sim.sourceRow;
+    builtInColumn = sim.sourceColumn;
+    if (builtInRow >= 0) {
+        cells.push_back({builtInRow, builtInColumn, sourceCount(), true});
+    }
+    // Stable, so sources sharing a cell apply in registration order.
+    std::stable_sort(cells.begin(), cells.end(), [](const Cell &a, const Cell &b) {
+        return a.i != b.i ? a.i < b.i : a.j < b.j;
+    });
+    rowFirst.assign(sim.M + 1, 0);
+    for (const Cell &cell: cells) {
+        rowFirst[cell.i + 1]++;
+    }
+    for (int i = 1; i <= sim.M; i++) {
+        rowFirst[i] += rowFirst[i - 1];
+    }
+    stale = false;
+}
+
+template <typename S, typename C>
+int BasicSourceSet<S, C>::prepare(int steps, double startTime) {
+    if (stale || builtInRow != sim.sourceRow || builtInColumn != sim.sourceColumn) {
+        rebuild();
+    }
+    if (cells.empty()) {
+        return steps;
+    }
+    steps = std::min(steps, kMaxLevels);
+    const int columns = sourceCount() + 1;
+    table.resize(static_cast<std::size_t>(steps) * columns);
+
+    const std::vector<double> times = sim.stepTimes(startTime, steps);
+    for (int level = 0; level < steps; level++) {
+        const double time = times[level];
+        C *row = &table[static_cast<std::size_t>(level) * columns];
+        for (int s = 0; s < sourceCount(); s++) {
+            const Source &source = sources[s];
+            row[s] = C(source.amplitude * waveformValue(waveforms[source.waveform], time - source.delay));
+        }
+        row[sourceCount()] = sim.rickertSource(C(time), C(0));
+    }
+    return steps;
+}
+
+template <typename S, typename C>
+void BasicSourceSet<S, C>::apply(int level, S *ez, int rowBegin, int rowEnd) {
+    const int begin = rowFirst[rowBegin], end = rowFirst[rowEnd];
+    if (begin == end) {
+        return;
+    }
+    const C *values = &table[static_cast<std::size_t>(level) * (sourceCount() + 1)];
+    const std::size_t pitch = sim.E_z.pitch();
+    for (int k = begin; k < end; k++) {
+        const Cell &cell = cells[k];
+        S &target = ez[cell.i * pitch + cell.j];
+        target = cell.hard ? S(values[cell.source]) : S(C(target) + values[cell.source]);
+    }
+}
+
+template <typename S, typename C>
+void BasicSourceSet<S, C>::applyElectricRows(int level, int rowBegin, int rowEnd) {
+    if (cells.empty() || rowBegin >= rowEnd) {
+        return;
+    }
+    apply(level, sim.E_z.origin(), rowBegin, rowEnd);
+}
+
+template <typename S, typename C>
+void BasicSourceSet<S, C>::applyElectricField(int level, S *ez) {
+    if (cells.empty()) {
+        return;
+    }
+    apply(level, ez, 1, sim.M - 1);
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicSourceSet<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
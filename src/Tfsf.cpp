@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Simulation.hpp"
+#include "Tfsf.hpp"
+
+bool parseTfsfDirection(const std::string &name, TfsfDirection &direction) {
+    static const char *const names[] = {"+i", "-i", "+j", "-j"};
+    for (int d = 0; d < 4; d++) {
+        if (name == names[d]) {
+            direction = static_cast<TfsfDirection>(d);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename S, typename C>
+BasicTfsf<S, C>::BasicTfsf(Simulation &sim, const TfsfParameters &parameters) : sim(sim), params(parameters) {
+    const MaskRect &r = params.region;
+    const int first = alongRows() ? r.i0 : r.j0;
+    const int last = alongRows() ? r.i1 : r.j1;
+    // Two cells ahead of the edge the wave enters through: the source and
+    // the H the first correction reads.
+    origin = forward() ? first - 2 : last + 1;
+    span = last - first + 2;
+
+    const int length = span + kLossCells;
+    auxE.assign(length, C(0));
+    auxH.assign(length, C(0));
+    ce.resize(length);
+    ch.resize(length);
+    hh.resize(length);
+    he.resize(length);
+    const MaterialCoefficients<C> vacuum = sim.vacuumCoefficients();
+    // Same loss for E and H keeps the layer matched; the cubic grading
+    // keeps its own reflection down.
+    auto loss = [&](double p) {
+        const double depth = std::max(0.0, (p - (span - 1)) / kLossCells);
+        return 0.35 * depth * depth * depth;
+    };
+    for (int p = 0; p < length; p++) {
+        const double e = loss(p), h = loss(p + 0.5);
+        ce[p] = C((1.0 - e) / (1.0 + e));
+        ch[p] = C(vacuum.ezh / (1.0 + e));
+        hh[p] = C((1.0 - h) / (1.0 + h));
+        he[p] = C(vacuum.hye / (1.0 + h));
+    }
+}
+
+template <typename S, typename C>
+bool BasicTfsf<S, C>::fits(int m, int n, int cpmlThickness, const MaskRect &region) {
+    const int margin = cpmlThickness + 2;
+    return !region.empty() && region.i0 >= margin && region.j0 >= margin && region.i1 <= m - margin &&
+        region.j1 <= n - margin;
+}
+
+template <typename S, typename C>
+int BasicTfsf<S, C>::prepare(int steps, double startTime) {
+    steps = std::min(steps, kMaxLevels);
+    incidentEs.resize(static_cast<std::size_t>(steps) * span);
+    incidentHs.resize(incidentEs.size());
+
+    const int length = static_cast<int>(auxE.size());
+    const std::vector<double> times = sim.stepTimes(startTime, steps);
+    for (int level = 0; level < steps; level++) {
+        std::copy(auxH.begin(), auxH.begin() + span, incidentHs.begin() + static_cast<std::size_t>(level) * span);
+        // The last cell stays zero and closes the lossy layer.
+        for (int p = 1; p < length - 1; p++) {
+            auxE[p] = ce[p] * auxE[p] + ch[p] * (auxH[p] - auxH[p-1]);
+        }
+        auxE[0] = sim.rickertSource(C(times[level]), C(0));
+        std::copy(auxE.begin(), auxE.begin() + span, incidentEs.begin() + static_cast<std::size_t>(level) * span);
+        for (int p = 0; p < length - 1; p++) {
+            auxH[p] = hh[p] * auxH[p] + he[p] * (auxE[p+1] - auxE[p]);
+        }
+    }
+    return steps;
+}
+
+template <typename S, typename C>
+C BasicTfsf<S, C>::incidentE(int level, int x) const {
+    return incidentEs[static_cast<std::size_t>(level) * span + (forward() ? x - origin : origin - x)];
+}
+
+template <typename S, typename C>
+C BasicTfsf<S, C>::incidentH(int level, int x) const {
+    const C *h = &incidentHs[static_cast<std::size_t>(level) * span];
+    return forward() ? h[x - origin] : -h[origin - x - 1];
+}
+
+// E_z in the first and last total-field rows (or columns) reads an H
+// outside the rectangle, which lacks the incident field.
+template <typename S, typename C>
+void BasicTfsf<S, C>::correctElectricRows(int level, int rowBegin, int rowEnd) {
+    const MaskRect &r = params.region;
+    auto add = [&](int i, int j, C value) {
+        if (!ConductorMask::test(sim.conductors.row(i), j)) {
+            S &ez = sim.E_z.get(i, j);
+            ez = S(C(ez) + sim.materials[sim.material.get(i, j)].ezh * value);
+        }
+    };
+
+    for (int i = std::max(rowBegin, r.i0); i < std::min(rowEnd, r.i1); i++) {
+        if (alongRows()) {
+            if (i == r.i0) {
+                const C h = incidentH(level, r.i0 - 1);
+                for (int j = r.j0; j < r.j1; j++) {
+                    add(i, j, -h);
+                }
+            }
+            if (i == r.i1 - 1) {
+                const C h = incidentH(level, r.i1 - 1);
+                for (int j = r.j0; j < r.j1; j++) {
+                    add(i, j, h);
+                }
+            }
+        } else {
+            // H_x is minus the auxiliary H.
+            add(i, r.j0, -incidentH(level, r.j0 - 1));
+            add(i, r.j1 - 1, incidentH(level, r.j1 - 1));
+        }
+    }
+}
+
+// H just outside the rectangle reads an E_z inside it, which holds the
+// incident field the scattered-field side must not see.
+template <typename S, typename C>
+void BasicTfsf<S, C>::correctMagneticRows(int level, int rowBegin, int rowEnd) {
+    const MaskRect &r = params.region;
+    auto incident = [&](int i, int j) { return incidentE(level, alongRows() ? i : j); };
+    auto add = [&](Linear2DVector<S> &field, C MaterialCoefficients<C>::*coefficient, int i, int j, C value) {
+        S &h = field.get(i, j);
+        h = S(C(h) + sim.materials[sim.material.get(i, j)].*coefficient * value);
+    };
+
+    for (int i = rowBegin; i < rowEnd; i++) {
+        if (i == r.i0 - 1) {
+            for (int j = r.j0; j < r.j1; j++) {
+                add(sim.H_y, &MaterialCoefficients<C>::hye, i, j, -incident(r.i0, j));
+            }
+        }
+        if (i == r.i1 - 1) {
+            for (int j = r.j0; j < r.j1; j++) {
+                add(sim.H_y, &MaterialCoefficients<C>::hye, i, j, incident(r.i1 - 1, j));
+            }
+        }
+        if (r.i0 <= i && i < r.i1) {
+            add(sim.H_x, &MaterialCoefficients<C>::hxe, i, r.j0 - 1, incident(i, r.j0));
+            add(sim.H_x, &MaterialCoefficients<C>::hxe, i, r.j1 - 1, -incident(i, r.j1 - 1));
+        }
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template class BasicTfsf<S, C>;
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
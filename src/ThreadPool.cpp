@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <numeric>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ThreadPool.hpp"
+
+static int resolveThreadCount(int threads) {
+    if (threads > 0) {
+        return threads;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+static void pinThread(std::thread &thread, int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    // macOS only offers affinity hints for groups of threads; leave the
+    // placement to the scheduler.
+    (void) thread;
+    (void) cpu;
+#endif
+}
+
+
+ThreadPool::ThreadPool(int threads, int firstCpu)
+    : numThreads(resolveThreadCount(threads)), sync(resolveThreadCount(threads)) {
+    for (int i = 1; i < numThreads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        if (firstCpu >= 0) {
+            pinThread(workers.back(), firstCpu + i);
+        }
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::run(const std::function<void(int)> &work) {
+    if (numThreads == 1) {
+        work(0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitted(submit);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &work;
+        pending = numThreads - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+}
+
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)> &body) {
+    run([&](int worker) {
+        int lo, hi;
+        partition(begin, end, worker, numThreads, lo, hi);
+        if (lo < hi) {
+            body(lo, hi);
+        }
+    });
+}
+
+
+void ThreadPool::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body) {
+    grain = std::max(1, grain);
+    std::atomic<int> next{begin};
+    run([&](int) {
+        for (int lo = next.fetch_add(grain); lo < end; lo = next.fetch_add(grain)) {
+            body(lo, std::min(end, lo + grain));
+        }
+    });
+}
+
+
+int ThreadPool::cacheAlignedRows(int rowBytes, int minimumRows) {
+    constexpr int cacheLine = 64;
+    const int rows = cacheLine / std::gcd(rowBytes, cacheLine);
+    return (std::max(1, minimumRows) + rows - 1) / rows * rows;
+}
+
+
+void ThreadPool::partition(int begin, int end, int worker, int count, int &chunkBegin, int &chunkEnd) {
+    int total = std::max(0, end - begin);
+    int base = total / count;
+    int extra = total % count;
+    chunkBegin = begin + worker * base + std::min(worker, extra);
+    chunkEnd = chunkBegin + base + (worker < extra ? 1 : 0);
+}
+
+
+void ThreadPool::workerLoop(int worker) {
+    std::uint64_t seen = 0;
+    while (true) {
+        const std::function<void(int)> *work;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            work = task;
+        }
+
+        (*work)(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        done.notify_one();
+    }
+}
@@ -0,0 +1,497 @@
+// Headless runner for the solver, meant for parameter sweeps on machines
+// without a display.
+//
+//   emsim_batch SCENARIO [--set "directive"]... [--output DIR] [--restart FILE]
+//
+// SCENARIO is described in Scenario.hpp; each --set line is applied after
+// the file, so one file can drive a sweep. With an output directory the
+// run writes the probes, snapshots of the fields
+// in snapshot_fields, ez_<step>.ppm colormapped images and stats.json.
+// Snapshots are either <field>_<step>.f32 files (M x N float32,
+// row-major) or, with snapshot_format chunked, frames appended to one
+// compressed fields.emsnap from a background thread (see
+// SnapshotFile.hpp). Probes are sampled every step by the solver (see
+// Probes.hpp); probes.csv gets every probe_interval-th of them, one column
+// per probe, and probe_format columnar writes them all to probes.emprb.
+// Each dft monitor is summed every step and written to dft_<name>.emdft
+// at the end (see DftMonitors.hpp).
+// Timing statistics are printed either way.
+//
+// With checkpoint_interval set, checkpoints (see Checkpoint.hpp) are
+// written in the background while the run goes on. A restarted run loads
+// one, takes its precision from it and continues from the saved step,
+// appending to probes.csv after cutting the rows written past it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Checkpoint.hpp"
+#include "Colormap.hpp"
+#include "Scenario.hpp"
+#include "Simulation.hpp"
+#include "SnapshotFile.hpp"
+#include "CpuBackend.hpp"
+
+#ifdef EMSIM_HAS_METAL
+#include "MetalBackend.hpp"
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template <typename S, typename C>
+static bool setUp(const Scenario &scenario, BasicSimulation<S, C> &sim, std::string &error) {
+    if (scenario.backend == "cpu") {
+        sim.template useBackend<BasicCpuBackend<S, C>>(scenario.threads);
+        static_cast<BasicCpuBackend<S, C>&>(sim.backend()).setTiling(scenario.tiling);
+    } else if (scenario.backend == "metal") {
+#ifdef EMSIM_HAS_METAL
+        if constexpr (std::is_same_v<S, float> && std::is_same_v<C, float>) {
+            sim.template useBackend<MetalBackend>();
+        } else {
+            error = "the metal backend only runs f32";
+            return false;
+        }
+#else
+        error = "built without the metal backend";
+        return false;
+#endif
+    } else {
+        error = "unknown backend " + scenario.backend;
+        return false;
+    }
+
+    if (scenario.pml > 0) {
+        CpmlParameters parameters;
+        parameters.thickness = scenario.pml;
+        if (!sim.setAbsorbingBoundary(parameters)) {
+            error = "pml does not fit the grid";
+            return false;
+        }
+    }
+
+    if (scenario.sourceRow >= 0) {
+        sim.sourceRow = scenario.sourceRow;
+        sim.sourceColumn = scenario.sourceColumn;
+    }
+    if (!scenario.pointSource) {
+        sim.sourceRow = -1;
+    }
+    for (const ScenarioWaveform &waveform: scenario.waveforms) {
+        SourceWaveform shape;
+        parseWaveformShape(waveform.shape, shape.shape);
+        shape.frequency = waveform.frequency;
+        shape.delay = waveform.delay;
+        shape.width = waveform.width;
+        shape.amplitude = waveform.amplitude;
+        shape.interval = waveform.interval;
+        if (!waveform.file.empty() && !loadWaveformSamples(waveform.file, shape.samples, error)) {
+            return false;
+        }
+        sim.sources.addWaveform(shape);
+    }
+    for (const ScenarioSource &source: scenario.sources) {
+        const auto found = std::find_if(scenario.waveforms.begin(), scenario.waveforms.end(),
+            [&](const ScenarioWaveform &waveform) { return waveform.name == source.waveform; });
+        if (found == scenario.waveforms.end()) {
+            error = "source uses undefined waveform " + source.waveform;
+            return false;
+        }
+        const int waveform = static_cast<int>(found - scenario.waveforms.begin());
+        const SourceMode mode = source.hard ? SourceMode::Hard : SourceMode::Soft;
+        int added;
+        if (source.kind == "point") {
+            added = sim.sources.addPoint(waveform, source.i0, source.j0, mode, source.amplitude, source.delay);
+        } else if (source.kind == "line") {
+            added = sim.sources.addLine(waveform, source.i0, source.j0, source.i1, source.j1, mode,
+                source.amplitude, source.delay);
+        } else {
+            added = sim.sources.addArea(waveform, {source.i0, source.j0, source.i1, source.j1}, mode,
+                source.amplitude, source.delay);
+        }
+        if (added < 0) {
+            error = "source_" + source.kind + " of " + source.waveform + " cannot be placed";
+            return false;
+        }
+    }
+
+    const ScenarioPlaneWave &wave = scenario.planeWave;
+    TfsfParameters planeWave;
+    planeWave.region = {wave.i0, wave.j0, wave.i1, wave.j1};
+    parseTfsfDirection(wave.direction, planeWave.direction);
+    if (!sim.setPlaneWave(planeWave)) {
+        error = "plane wave does not fit inside the boundary";
+        return false;
+    }
+
+    std::vector<int> ids;
+    for (const ScenarioMaterial &material: scenario.materials) {
+        int id = sim.addMaterial(MaterialProperties{material.epsr, material.mur, material.loss, material.magneticLoss});
+        if (id < 0) {
+            error = "too many materials";
+            return false;
+        }
+        ids.push_back(id);
+    }
+    for (const ScenarioPole &pole: scenario.poles) {
+        int id = -1;
+        for (size_t k = 0; k < scenario.materials.size(); k++) {
+            if (scenario.materials[k].name == pole.material) {
+                id = ids[k];
+            }
+        }
+        DispersivePole dispersive;
+        parseDispersivePoleKind(pole.kind, dispersive.kind);
+        dispersive.deltaEpsilon = pole.deltaEpsilon;
+        dispersive.frequency = pole.frequency;
+        dispersive.damping = pole.damping;
+        dispersive.relaxationTime = pole.relaxationTime;
+        if (!sim.dispersion.addPole(id, dispersive)) {
+            error = "dispersion of " + pole.material + ": invalid pole or too many poles";
+            return false;
+        }
+    }
+
+    for (const ScenarioRegion &region: scenario.regions) {
+        if (region.material.empty()) {
+            sim.fillConductors({region.i0, region.j0, region.i1, region.j1});
+            continue;
+        }
+        int id = -1;
+        for (size_t k = 0; k < scenario.materials.size(); k++) {
+            if (scenario.materials[k].name == region.material) {
+                id = ids[k];
+            }
+        }
+        sim.fillMaterial({region.i0, region.j0, region.i1, region.j1}, id);
+    }
+
+    for (const ScenarioProbe &probe: scenario.probes) {
+        FieldComponent field;
+        if (!parseFieldComponent(probe.field, field)) {
+            error = "probe " + probe.name + ": unknown field " + probe.field;
+            return false;
+        }
+        int column;
+        if (probe.i1 >= 0) {
+            column = sim.probes.addLine(probe.name, field, probe.i, probe.j, probe.i1, probe.j1);
+        } else {
+            column = sim.probes.addPoint(probe.name, field, probe.i, probe.j);
+        }
+        if (column < 0) {
+            error = "probe " + probe.name + " outside the grid";
+            return false;
+        }
+    }
+
+    for (const ScenarioDft &dft: scenario.dfts) {
+        FieldComponent field;
+        if (!parseFieldComponent(dft.field, field)) {
+            error = "dft " + dft.name + ": unknown field " + dft.field;
+            return false;
+        }
+        if (sim.dft.add(dft.name, field, {dft.i0, dft.j0, dft.i1, dft.j1}, dft.frequencies) < 0) {
+            error = "dft " + dft.name + ": empty region or no frequency";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes every interval-th sample the probes hold as CSV rows and empties
+// them.
+template <typename S, typename C>
+static void writeProbeRows(BasicProbeSet<S, C> &probes, int interval, std::ofstream &csv) {
+    for (int k = 0; k < probes.sampleCount(); k++) {
+        if (probes.sampleStep(k) % interval != 0) {
+            continue;
+        }
+        csv << probes.sampleStep(k) << "," << probes.sampleTime(k);
+        for (int c = 0; c < probes.columnCount(); c++) {
+            csv << "," << probes.sample(k, c);
+        }
+        csv << "\n";
+    }
+    probes.discard();
+}
+
+// Cuts probes.csv after the last whole row at or before keepUntil, so a
+// restarted run does not repeat the rows written after its checkpoint.
+// Returns false if not even the header is left.
+static bool truncateProbeRows(const std::filesystem::path &path, long keepUntil) {
+    std::ifstream csv(path, std::ios::binary);
+    std::string line;
+    std::getline(csv, line);
+    std::streamoff keep = csv.good() ? static_cast<std::streamoff>(csv.tellg()) : 0;
+    while (std::getline(csv, line) && !csv.eof() && std::strtol(line.c_str(), nullptr, 10) <= keepUntil) {
+        keep = csv.tellg();
+    }
+    csv.close();
+    std::filesystem::resize_file(path, static_cast<std::uintmax_t>(keep));
+    return keep > 0;
+}
+
+template <typename S, typename C>
+static void writeSnapshot(BasicSimulation<S, C> &sim, FieldComponent field, const std::filesystem::path &path) {
+    sim.synchronize();
+    std::vector<float> row(sim.N);
+    std::ofstream file(path, std::ios::binary);
+    for (int i = 0; i < sim.M; i++) {
+        const S *values = sim.field(field).row(i);
+        for (int j = 0; j < sim.N; j++) {
+            row[j] = float(values[j]);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+    }
+}
+
+template <typename S, typename C>
+static void writeColorImage(BasicSimulation<S, C> &sim, const FieldColorizer &colorizer,
+    const std::filesystem::path &path) {
+    sim.synchronize();
+    Linear2DVector<float> field(sim.M, sim.N);
+    for (int i = 0; i < sim.M; i++) {
+        for (int j = 0; j < sim.N; j++) {
+            field.get(i, j) = float(sim.E_z.get(i, j));
+        }
+    }
+    std::vector<std::uint32_t> pixels(static_cast<size_t>(sim.M) * sim.N);
+    ColorRange range = colorizer.frameRange(field.origin(), field.pitch(), sim.M, sim.N);
+    colorizer.colorizeRows(field.origin(), field.pitch(), &sim.conductors, pixels.data(), sim.N, 0, sim.M, sim.N,
+        range);
+    writeImage(path.string(), pixels.data(), sim.N, sim.M);
+}
+
+template <typename S, typename C>
+static int run(const Scenario &scenario) {
+    auto start = Clock::now();
+
+    BasicSimulation<S, C> sim(scenario.M, scenario.N, C(scenario.deltaX), C(scenario.deltaY), C(scenario.deltaT));
+    std::string error;
+    if (!setUp(scenario, sim, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    long restartStep = 0;
+    if (!scenario.restart.empty()) {
+        if (!loadCheckpoint(sim, scenario.restart, restartStep, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::printf("resuming at step %ld from %s\n", restartStep, scenario.restart.c_str());
+    }
+    sim.probes.setStep(restartStep);
+
+    std::filesystem::path output;
+    std::ofstream probes;
+    if (!scenario.output.empty()) {
+        output = scenario.output;
+        std::filesystem::create_directories(output);
+        if (!sim.probes.empty() && scenario.probeFormat == "columnar") {
+            if (!sim.probes.openOutput((output / "probes.emprb").string(), error, restartStep > 0, restartStep)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        } else if (!sim.probes.empty()) {
+            const bool append = restartStep > 0 && std::filesystem::exists(output / "probes.csv") &&
+                truncateProbeRows(output / "probes.csv", restartStep);
+            probes.open(output / "probes.csv", append ? std::ios::app : std::ios::out);
+            if (!append) {
+                probes << "step,time";
+                for (int c = 0; c < sim.probes.columnCount(); c++) {
+                    probes << "," << sim.probes.column(c).name;
+                }
+                probes << "\n";
+            }
+        }
+    }
+    const bool checkpoints = scenario.checkpointInterval > 0;
+    const std::string checkpointPath =
+        scenario.checkpoint.empty() ? (output / "checkpoint.emck").string() : scenario.checkpoint;
+    BasicCheckpointWriter<S, C> checkpointWriter;
+    FieldColorizer colorizer(*Colormap::find(scenario.colormap));
+    if (scenario.colorRange == "symmetric") {
+        colorizer.setRangeMode(RangeMode::Symmetric);
+    } else if (scenario.colorRange == "auto") {
+        colorizer.setRangeMode(RangeMode::Auto);
+    } else {
+        colorizer.setRange({float(scenario.colorLow), float(scenario.colorHigh)});
+    }
+    const bool images = scenario.imageInterval > 0 && !output.empty();
+    const bool snapshots = scenario.snapshotInterval > 0 && !output.empty();
+    unsigned snapshotFields = 0;
+    for (const std::string &name: scenario.snapshotFields) {
+        FieldComponent field;
+        if (!parseFieldComponent(name, field)) {
+            std::cerr << "unknown snapshot field " << name << std::endl;
+            return 1;
+        }
+        snapshotFields |= snapshotFieldBit(field);
+    }
+    SnapshotWriter snapshotWriter;
+    if (snapshots && scenario.snapshotFormat == "chunked" &&
+        !snapshotWriter.open((output / "fields.emsnap").string(), sim.M, sim.N, snapshotFields, error,
+            restartStep > 0, restartStep)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    const double setupSeconds = secondsSince(start);
+
+    double stepSeconds = 0.0;
+    double outputSeconds = 0.0;
+    int step = static_cast<int>(restartStep);
+    while (step < scenario.steps) {
+        // Advance to the next step something has to be recorded at.
+        int next = scenario.steps;
+        if (probes.is_open()) {
+            // Before the probes' ring wraps.
+            next = std::min(next, step + sim.probes.capacity());
+        }
+        if (snapshots) {
+            next = std::min(next, (step / scenario.snapshotInterval + 1) * scenario.snapshotInterval);
+        }
+        if (images) {
+            next = std::min(next, (step / scenario.imageInterval + 1) * scenario.imageInterval);
+        }
+        if (checkpoints) {
+            next = std::min(next, (step / scenario.checkpointInterval + 1) * scenario.checkpointInterval);
+        }
+
+        auto stepStart = Clock::now();
+        sim.advance(next - step);
+        stepSeconds += secondsSince(stepStart);
+        step = next;
+
+        auto outputStart = Clock::now();
+        if (probes.is_open()) {
+            writeProbeRows(sim.probes, scenario.probeInterval, probes);
+        }
+        if (snapshots && step % scenario.snapshotInterval == 0) {
+            if (snapshotWriter.isOpen()) {
+                snapshotWriter.capture(sim, step);
+            } else {
+                for (int f = 0; f < kFieldComponentCount; f++) {
+                    const FieldComponent field = static_cast<FieldComponent>(f);
+                    if ((snapshotFields >> f) & 1) {
+                        writeSnapshot(sim, field,
+                            output / (std::string(fieldComponentName(field)) + "_" + std::to_string(step) + ".f32"));
+                    }
+                }
+            }
+        }
+        if (images && step % scenario.imageInterval == 0) {
+            writeColorImage(sim, colorizer, output / ("ez_" + std::to_string(step) + ".ppm"));
+        }
+        if (checkpoints && step % scenario.checkpointInterval == 0) {
+            // Probe blocks end at checkpoints, so a restart can keep them.
+            if (!sim.probes.flush(error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            checkpointWriter.save(sim, checkpointPath, step);
+        }
+        outputSeconds += secondsSince(outputStart);
+    }
+    sim.synchronize();
+    if (!sim.probes.closeOutput(error) || !snapshotWriter.close(error) || !checkpointWriter.wait(error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    for (int m = 0; m < sim.dft.monitorCount() && !output.empty(); m++) {
+        if (!sim.dft.write(m, (output / ("dft_" + sim.dft.monitor(m).name + ".emdft")).string(), error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+
+    const double totalSeconds = secondsSince(start);
+    const double cells = static_cast<double>(scenario.M) * scenario.N * (scenario.steps - restartStep);
+    const double cellsPerSecond = stepSeconds > 0.0 ? cells / stepSeconds : 0.0;
+
+    std::printf("grid %dx%d %s %s, %d steps\n", scenario.M, scenario.N, scenario.precision.c_str(),
+        sim.backend().name(), scenario.steps);
+    std::printf("setup    %10.3f s\n", setupSeconds);
+    std::printf("stepping %10.3f s  (%.1f Mcells/s)\n", stepSeconds, cellsPerSecond / 1e6);
+    std::printf("output   %10.3f s\n", outputSeconds);
+    std::printf("total    %10.3f s\n", totalSeconds);
+
+    if (!output.empty()) {
+        std::ofstream stats(output / "stats.json");
+        stats << "{\"M\": " << scenario.M << ", \"N\": " << scenario.N << ", \"steps\": " << scenario.steps
+              << ", \"precision\": \"" << scenario.precision << "\", \"backend\": \"" << sim.backend().name()
+              << "\", \"setup_seconds\": " << setupSeconds << ", \"step_seconds\": " << stepSeconds
+              << ", \"output_seconds\": " << outputSeconds << ", \"total_seconds\": " << totalSeconds
+              << ", \"cells_per_second\": " << cellsPerSecond << "}\n";
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: emsim_batch SCENARIO [--set \"directive\"]... [--output DIR] [--restart FILE]"
+                  << std::endl;
+        return 1;
+    }
+
+    Scenario scenario;
+    std::string error;
+    if (!loadScenario(argv[1], scenario, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        std::string line;
+        if (std::strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            line = argv[++i];
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            line = std::string("output ") + argv[++i];
+        } else if (std::strcmp(argv[i], "--restart") == 0 && i + 1 < argc) {
+            line = std::string("restart ") + argv[++i];
+        } else {
+            std::cerr << "Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+        if (!parseScenarioLine(line, scenario, error)) {
+            std::cerr << "--set " << line << ": " << error << std::endl;
+            return 1;
+        }
+    }
+    if (!scenario.restart.empty()) {
+        CheckpointInfo info;
+        if (!readCheckpointInfo(scenario.restart, info, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        scenario.precision = info.precision;
+    }
+    if (!validateScenario(scenario, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if (scenario.precision == "f32") {
+        return run<float, float>(scenario);
+    } else if (scenario.precision == "f64") {
+        return run<double, double>(scenario);
+    } else if (scenario.precision == "f16") {
+        return run<Half, float>(scenario);
+    } else if (scenario.precision == "bf16") {
+        return run<BFloat16, float>(scenario);
+    }
+    std::cerr << "Unknown precision " << scenario.precision << std::endl;
+    return 1;
+}
@@ -0,0 +1,106 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "Kernels.hpp"
+
+static bool cpuSupports(const char *isa) {
+    if (std::strcmp(isa, "scalar") == 0) {
+        return true;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (std::strcmp(isa, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+            __builtin_cpu_supports("f16c");
+    }
+    if (std::strcmp(isa, "avx512") == 0) {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512vl");
+    }
+#endif
+#if defined(__aarch64__)
+    if (std::strcmp(isa, "neon") == 0) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+
+template <typename S, typename C>
+const KernelTable<S, C> *findKernels(const char *isa) {
+    // widest first
+    const KernelTable<S, C> *const available[] = {
+#ifdef EMSIM_HAVE_AVX512
+        avx512Kernels<S, C>(),
+#endif
+#ifdef EMSIM_HAVE_AVX2
+        avx2Kernels<S, C>(),
+#endif
+#ifdef EMSIM_HAVE_NEON
+        neonKernels<S, C>(),
+#endif
+        scalarKernels<S, C>(),
+    };
+
+    for (const KernelTable<S, C> *table: available) {
+        if (table && (isa == nullptr || std::strcmp(table->isa, isa) == 0) && cpuSupports(table->isa)) {
+            return table;
+        }
+    }
+    return nullptr;
+}
+
+
+template <typename S, typename C>
+const KernelTable<S, C> &selectKernels() {
+    static const KernelTable<S, C> *selected = [] {
+        const KernelTable<S, C> *table = nullptr;
+        if (const char *forced = std::getenv("EMSIM_ISA")) {
+            table = findKernels<S, C>(forced);
+        }
+        return table ? table : findKernels<S, C>(nullptr);
+    }();
+    return *selected;
+}
+
+#define EMSIM_INSTANTIATE(S, C) \
+    template const KernelTable<S, C> *findKernels<S, C>(const char *isa); \
+    template const KernelTable<S, C> &selectKernels<S, C>();
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
+
+
+const ColorizeTable *findColorizer(const char *isa) {
+    const ColorizeTable *const available[] = {
+#ifdef EMSIM_HAVE_AVX512
+        avx512Colorizer(),
+#endif
+#ifdef EMSIM_HAVE_AVX2
+        avx2Colorizer(),
+#endif
+#ifdef EMSIM_HAVE_NEON
+        neonColorizer(),
+#endif
+        scalarColorizer(),
+    };
+
+    for (const ColorizeTable *table: available) {
+        if (isa == nullptr || std::strcmp(table->isa, isa) == 0) {
+            if (cpuSupports(table->isa)) {
+                return table;
+            }
+        }
+    }
+    return nullptr;
+}
+
+const ColorizeTable &selectColorizer() {
+    static const ColorizeTable *selected = [] {
+        const ColorizeTable *table = nullptr;
+        if (const char *forced = std::getenv("EMSIM_ISA")) {
+            table = findColorizer(forced);
+        }
+        return table ? table : findColorizer(nullptr);
+    }();
+    return *selected;
+}
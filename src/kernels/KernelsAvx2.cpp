@@ -0,0 +1,248 @@
+#include <type_traits>
+#include <immintrin.h>
+
+#include "Kernels.hpp"
+
+// 8 cells per instruction. Built with -mavx2 -mfma -mf16c and only called
+// after selectKernels() has checked the CPU. float, Half and BFloat16
+// storage all compute in float; double has no kernels here.
+
+template <typename S>
+static inline __m256 load8(const S *p) {
+    if constexpr (std::is_same_v<S, float>) {
+        return _mm256_loadu_ps(p);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    } else {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+    }
+}
+
+template <typename S>
+static inline void store8(S *p, __m256 v) {
+    if constexpr (std::is_same_v<S, float>) {
+        _mm256_storeu_ps(p, v);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    } else {
+        // round to nearest even on the dropped 16 bits
+        __m256i w = _mm256_castps_si256(v);
+        __m256i odd = _mm256_and_si256(_mm256_srli_epi32(w, 16), _mm256_set1_epi32(1));
+        __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(w, _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), odd)), 16);
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), packed);
+    }
+}
+
+// Coefficient pair (c[0], c[1]) of the material of 8 cells.
+static inline void gather8(const float *coefficients, const std::uint8_t *material, __m256 &first, __m256 &second) {
+    __m256i ids = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(material)));
+    __m256i offsets = _mm256_mullo_epi32(ids, _mm256_set1_epi32(kCoefficientStride));
+    first = _mm256_i32gather_ps(coefficients, offsets, 4);
+    second = _mm256_i32gather_ps(coefficients + 1, offsets, 4);
+}
+
+// Conductor bits of columns nn .. nn+7, lane k nonzero if column nn+k is set.
+static inline __m256i conductorLanes8(const ConductorMask::Word *mask, int nn) {
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(ConductorMask::bits(mask, nn) & 0xff)), lanes);
+}
+
+template <typename S>
+static inline __m256 curl8(const ElectricRow<S, float> &r, int nn) {
+    return _mm256_sub_ps(
+        _mm256_sub_ps(load8(r.hy + nn), load8(r.hyPrev + nn)),
+        _mm256_sub_ps(load8(r.hx + nn), load8(r.hx + nn - 1)));
+}
+
+template <typename S>
+static void electricRow(const ElectricRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 ce, ch;
+        gather8(r.coefficients, r.material + nn, ce, ch);
+        __m256 value = _mm256_fmadd_ps(ch, curl8(r, nn), _mm256_mul_ps(ce, load8(r.ez + nn)));
+
+        __m256i cond = conductorLanes8(r.conductor, nn);
+        __m256 vacuum = _mm256_castsi256_ps(_mm256_cmpeq_epi32(cond, _mm256_setzero_si256()));
+        store8(r.ez + nn, _mm256_and_ps(vacuum, value));
+    }
+    scalarKernels<S, float>()->electricRow(r, nn, end);
+}
+
+template <typename S>
+static void magneticXRow(const MagneticRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 hh, he;
+        gather8(r.coefficients, r.material + nn, hh, he);
+        __m256 diff = _mm256_sub_ps(load8(r.ez + nn + 1), load8(r.ez + nn));
+        store8(r.h + nn, _mm256_fnmadd_ps(he, diff, _mm256_mul_ps(hh, load8(r.h + nn))));
+    }
+    scalarKernels<S, float>()->magneticXRow(r, nn, end);
+}
+
+template <typename S>
+static void magneticYRow(const MagneticRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 hh, he;
+        gather8(r.coefficients, r.material + nn, hh, he);
+        __m256 diff = _mm256_sub_ps(load8(r.ezNext + nn), load8(r.ez + nn));
+        store8(r.h + nn, _mm256_fmadd_ps(he, diff, _mm256_mul_ps(hh, load8(r.h + nn))));
+    }
+    scalarKernels<S, float>()->magneticYRow(r, nn, end);
+}
+
+template <typename S>
+static void electricRowUniform(const ElectricRow<S, float> &r, float ce, float ch, int begin, int end) {
+    const __m256 vce = _mm256_set1_ps(ce);
+    const __m256 vch = _mm256_set1_ps(ch);
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        store8(r.ez + nn, _mm256_fmadd_ps(vch, curl8(r, nn), _mm256_mul_ps(vce, load8(r.ez + nn))));
+    }
+    scalarKernels<S, float>()->electricRowUniform(r, ce, ch, nn, end);
+}
+
+template <typename S>
+static void magneticXRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const __m256 vhh = _mm256_set1_ps(hh);
+    const __m256 vhe = _mm256_set1_ps(he);
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 diff = _mm256_sub_ps(load8(r.ez + nn + 1), load8(r.ez + nn));
+        store8(r.h + nn, _mm256_fnmadd_ps(vhe, diff, _mm256_mul_ps(vhh, load8(r.h + nn))));
+    }
+    scalarKernels<S, float>()->magneticXRowUniform(r, hh, he, nn, end);
+}
+
+template <typename S>
+static void magneticYRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const __m256 vhh = _mm256_set1_ps(hh);
+    const __m256 vhe = _mm256_set1_ps(he);
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 diff = _mm256_sub_ps(load8(r.ezNext + nn), load8(r.ez + nn));
+        store8(r.h + nn, _mm256_fmadd_ps(vhe, diff, _mm256_mul_ps(vhh, load8(r.h + nn))));
+    }
+    scalarKernels<S, float>()->magneticYRowUniform(r, hh, he, nn, end);
+}
+
+template <typename S>
+static void dftRow(const S *field, float *re, float *im, float cosine, float sine, int n) {
+    const __m256 vc = _mm256_set1_ps(cosine);
+    const __m256 vs = _mm256_set1_ps(sine);
+    int nn = 0;
+    for (; nn + 8 <= n; nn += 8) {
+        __m256 value = load8(field + nn);
+        _mm256_storeu_ps(re + nn, _mm256_fmadd_ps(vc, value, _mm256_loadu_ps(re + nn)));
+        _mm256_storeu_ps(im + nn, _mm256_fmadd_ps(vs, value, _mm256_loadu_ps(im + nn)));
+    }
+    scalarKernels<S, float>()->dftRow(field + nn, re + nn, im + nn, cosine, sine, n - nn);
+}
+
+static void poleHistory(const float *polarization, const float *carry, float *history,
+    const PoleCoefficients<float> &pole, int n) {
+    const __m256 growth = _mm256_set1_ps(pole.alpha - 1.0f);
+    int nn = 0;
+    for (; nn + 8 <= n; nn += 8) {
+        const __m256 known = _mm256_fmadd_ps(growth, _mm256_loadu_ps(polarization + nn), _mm256_loadu_ps(carry + nn));
+        _mm256_storeu_ps(history + nn, _mm256_add_ps(_mm256_loadu_ps(history + nn), known));
+    }
+    scalarKernels<float, float>()->poleHistory(polarization + nn, carry + nn, history + nn, pole, n - nn);
+}
+
+static void poleStep(float *polarization, float *carry, const float *e, const float *previous,
+    const PoleCoefficients<float> &pole, int n) {
+    const __m256 alpha = _mm256_set1_ps(pole.alpha), xi = _mm256_set1_ps(pole.xi);
+    const __m256 drive = _mm256_set1_ps(pole.drive), lead = _mm256_set1_ps(pole.lead), lag = _mm256_set1_ps(pole.lag);
+    int nn = 0;
+    for (; nn + 8 <= n; nn += 8) {
+        const __m256 p = _mm256_loadu_ps(polarization + nn);
+        const __m256 value = _mm256_loadu_ps(e + nn);
+        const __m256 next = _mm256_fmadd_ps(drive, value, _mm256_fmadd_ps(alpha, p, _mm256_loadu_ps(carry + nn)));
+        const __m256 carried = _mm256_fmadd_ps(lag, _mm256_loadu_ps(previous + nn),
+            _mm256_fmadd_ps(lead, value, _mm256_mul_ps(xi, p)));
+        _mm256_storeu_ps(polarization + nn, next);
+        _mm256_storeu_ps(carry + nn, carried);
+    }
+    scalarKernels<float, float>()->poleStep(polarization + nn, carry + nn, e + nn, previous + nn, pole, n - nn);
+}
+
+template <typename S>
+static inline __m256 curlDifference8(const CurlRow<S, float> &r, int nn) {
+    return _mm256_sub_ps(
+        _mm256_sub_ps(load8(r.a + nn), load8(r.aPrev + nn)),
+        _mm256_sub_ps(load8(r.b + nn), load8(r.bPrev + nn)));
+}
+
+template <typename S>
+static void curlRow(const CurlRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        __m256 c0, c1;
+        gather8(r.coefficients, r.material + nn, c0, c1);
+        store8(r.f + nn, _mm256_fmadd_ps(c1, curlDifference8(r, nn), _mm256_mul_ps(c0, load8(r.f + nn))));
+    }
+    scalarKernels<S, float>()->curlRow(r, nn, end);
+}
+
+template <typename S>
+static void curlRowUniform(const CurlRow<S, float> &r, float c0, float c1, int begin, int end) {
+    const __m256 vc0 = _mm256_set1_ps(c0);
+    const __m256 vc1 = _mm256_set1_ps(c1);
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        store8(r.f + nn, _mm256_fmadd_ps(vc1, curlDifference8(r, nn), _mm256_mul_ps(vc0, load8(r.f + nn))));
+    }
+    scalarKernels<S, float>()->curlRowUniform(r, c0, c1, nn, end);
+}
+
+template <typename S, typename C>
+const KernelTable<S, C> *avx2Kernels() {
+    if constexpr (std::is_same_v<C, float>) {
+        static const KernelTable<S, C> table = {"avx2",
+            electricRow<S>, magneticXRow<S>, magneticYRow<S>,
+            electricRowUniform<S>, magneticXRowUniform<S>, magneticYRowUniform<S>, dftRow<S>,
+            poleHistory, poleStep, curlRow<S>, curlRowUniform<S>};
+        return &table;
+    } else {
+        return nullptr;
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template const KernelTable<S, C> *avx2Kernels<S, C>();
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
+
+static void colorizeRow(const float *values, const ConductorMask::Word *conductor, std::uint32_t *out, int n,
+    const ColorizeParams &params) {
+    const __m256 scale = _mm256_set1_ps(params.scale);
+    const __m256 offset = _mm256_set1_ps(params.offset);
+    const __m256 top = _mm256_set1_ps(params.maxIndex);
+    const __m256i conductorColor = _mm256_set1_epi32(static_cast<int>(params.conductorColor));
+    const int *lut = reinterpret_cast<const int*>(params.lut);
+
+    int nn = 0;
+    for (; nn + 8 <= n; nn += 8) {
+        // max_ps returns its second operand for NaN
+        __m256 t = _mm256_fmadd_ps(_mm256_loadu_ps(values + nn), scale, offset);
+        t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), top);
+        __m256i color = _mm256_i32gather_epi32(lut, _mm256_cvttps_epi32(t), 4);
+        if (conductor) {
+            __m256i flags = conductorLanes8(conductor, nn);
+            __m256i vacuum = _mm256_cmpeq_epi32(flags, _mm256_setzero_si256());
+            color = _mm256_blendv_epi8(conductorColor, color, vacuum);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + nn), color);
+    }
+    for (; nn < n; ++nn) {
+        out[nn] = colorizeValue(values[nn], conductor && ConductorMask::test(conductor, nn), params);
+    }
+}
+
+const ColorizeTable *avx2Colorizer() {
+    static const ColorizeTable table = {"avx2", colorizeRow};
+    return &table;
+}
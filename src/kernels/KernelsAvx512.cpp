@@ -0,0 +1,233 @@
+#include <type_traits>
+#include <immintrin.h>
+
+#include "Kernels.hpp"
+
+// 16 cells per instruction, with the row tail handled by masked loads and
+// stores instead of a scalar loop. Built with -mavx512f -mavx512bw
+// -mavx512vl. float, Half and BFloat16 storage all compute in float.
+
+static inline __mmask16 tailMask(int remaining) {
+    return remaining >= 16 ? (__mmask16) 0xFFFF : (__mmask16) ((1u << remaining) - 1);
+}
+
+template <typename S>
+static inline __m512 load16(__mmask16 m, const S *p) {
+    if constexpr (std::is_same_v<S, float>) {
+        return _mm512_maskz_loadu_ps(m, p);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        return _mm512_cvtph_ps(_mm256_maskz_loadu_epi16(m, p));
+    } else {
+        __m512i wide = _mm512_cvtepu16_epi32(_mm256_maskz_loadu_epi16(m, p));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(wide, 16));
+    }
+}
+
+template <typename S>
+static inline void store16(__mmask16 m, S *p, __m512 v) {
+    if constexpr (std::is_same_v<S, float>) {
+        _mm512_mask_storeu_ps(p, m, v);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        _mm256_mask_storeu_epi16(p, m, _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    } else {
+        // round to nearest even on the dropped 16 bits
+        __m512i w = _mm512_castps_si512(v);
+        __m512i odd = _mm512_and_si512(_mm512_srli_epi32(w, 16), _mm512_set1_epi32(1));
+        __m512i rounded = _mm512_srli_epi32(_mm512_add_epi32(w, _mm512_add_epi32(_mm512_set1_epi32(0x7FFF), odd)), 16);
+        _mm256_mask_storeu_epi16(p, m, _mm512_cvtepi32_epi16(rounded));
+    }
+}
+
+// Coefficient pair (c[0], c[1]) of the material of 16 cells.
+static inline void gather16(__mmask16 m, const float *coefficients, const std::uint8_t *material, __m512 &first, __m512 &second) {
+    __m512i ids = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(m, material));
+    __m512i offsets = _mm512_mullo_epi32(ids, _mm512_set1_epi32(kCoefficientStride));
+    first = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, offsets, coefficients, 4);
+    second = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), m, offsets, coefficients + 1, 4);
+}
+
+template <typename S>
+static inline __m512 curl16(__mmask16 m, const ElectricRow<S, float> &r, int nn) {
+    return _mm512_sub_ps(
+        _mm512_sub_ps(load16(m, r.hy + nn), load16(m, r.hyPrev + nn)),
+        _mm512_sub_ps(load16(m, r.hx + nn), load16(m, r.hx + nn - 1)));
+}
+
+template <typename S>
+static void electricRow(const ElectricRow<S, float> &r, int begin, int end) {
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 ce, ch;
+        gather16(m, r.coefficients, r.material + nn, ce, ch);
+        __m512 value = _mm512_fmadd_ps(ch, curl16(m, r, nn), _mm512_mul_ps(ce, load16(m, r.ez + nn)));
+
+        __mmask16 vacuum = m & ~static_cast<__mmask16>(ConductorMask::bits(r.conductor, nn));
+        // Conductor cells are zeroed, cells past the tail are left alone.
+        store16(m, r.ez + nn, _mm512_maskz_mov_ps(vacuum, value));
+    }
+}
+
+template <typename S>
+static void magneticXRow(const MagneticRow<S, float> &r, int begin, int end) {
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 hh, he;
+        gather16(m, r.coefficients, r.material + nn, hh, he);
+        __m512 diff = _mm512_sub_ps(load16(m, r.ez + nn + 1), load16(m, r.ez + nn));
+        store16(m, r.h + nn, _mm512_fnmadd_ps(he, diff, _mm512_mul_ps(hh, load16(m, r.h + nn))));
+    }
+}
+
+template <typename S>
+static void magneticYRow(const MagneticRow<S, float> &r, int begin, int end) {
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 hh, he;
+        gather16(m, r.coefficients, r.material + nn, hh, he);
+        __m512 diff = _mm512_sub_ps(load16(m, r.ezNext + nn), load16(m, r.ez + nn));
+        store16(m, r.h + nn, _mm512_fmadd_ps(he, diff, _mm512_mul_ps(hh, load16(m, r.h + nn))));
+    }
+}
+
+template <typename S>
+static void electricRowUniform(const ElectricRow<S, float> &r, float ce, float ch, int begin, int end) {
+    const __m512 vce = _mm512_set1_ps(ce);
+    const __m512 vch = _mm512_set1_ps(ch);
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        store16(m, r.ez + nn, _mm512_fmadd_ps(vch, curl16(m, r, nn), _mm512_mul_ps(vce, load16(m, r.ez + nn))));
+    }
+}
+
+template <typename S>
+static void magneticXRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const __m512 vhh = _mm512_set1_ps(hh);
+    const __m512 vhe = _mm512_set1_ps(he);
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 diff = _mm512_sub_ps(load16(m, r.ez + nn + 1), load16(m, r.ez + nn));
+        store16(m, r.h + nn, _mm512_fnmadd_ps(vhe, diff, _mm512_mul_ps(vhh, load16(m, r.h + nn))));
+    }
+}
+
+template <typename S>
+static void magneticYRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const __m512 vhh = _mm512_set1_ps(hh);
+    const __m512 vhe = _mm512_set1_ps(he);
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 diff = _mm512_sub_ps(load16(m, r.ezNext + nn), load16(m, r.ez + nn));
+        store16(m, r.h + nn, _mm512_fmadd_ps(vhe, diff, _mm512_mul_ps(vhh, load16(m, r.h + nn))));
+    }
+}
+
+template <typename S>
+static void dftRow(const S *field, float *re, float *im, float cosine, float sine, int n) {
+    const __m512 vc = _mm512_set1_ps(cosine);
+    const __m512 vs = _mm512_set1_ps(sine);
+    for (int nn = 0; nn < n; nn += 16) {
+        __mmask16 m = tailMask(n - nn);
+        __m512 value = load16(m, field + nn);
+        _mm512_mask_storeu_ps(re + nn, m, _mm512_fmadd_ps(vc, value, _mm512_maskz_loadu_ps(m, re + nn)));
+        _mm512_mask_storeu_ps(im + nn, m, _mm512_fmadd_ps(vs, value, _mm512_maskz_loadu_ps(m, im + nn)));
+    }
+}
+
+static void poleHistory(const float *polarization, const float *carry, float *history,
+    const PoleCoefficients<float> &pole, int n) {
+    const __m512 growth = _mm512_set1_ps(pole.alpha - 1.0f);
+    for (int nn = 0; nn < n; nn += 16) {
+        __mmask16 m = tailMask(n - nn);
+        const __m512 known = _mm512_fmadd_ps(growth, _mm512_maskz_loadu_ps(m, polarization + nn),
+            _mm512_maskz_loadu_ps(m, carry + nn));
+        _mm512_mask_storeu_ps(history + nn, m, _mm512_add_ps(_mm512_maskz_loadu_ps(m, history + nn), known));
+    }
+}
+
+static void poleStep(float *polarization, float *carry, const float *e, const float *previous,
+    const PoleCoefficients<float> &pole, int n) {
+    const __m512 alpha = _mm512_set1_ps(pole.alpha), xi = _mm512_set1_ps(pole.xi);
+    const __m512 drive = _mm512_set1_ps(pole.drive), lead = _mm512_set1_ps(pole.lead), lag = _mm512_set1_ps(pole.lag);
+    for (int nn = 0; nn < n; nn += 16) {
+        __mmask16 m = tailMask(n - nn);
+        const __m512 p = _mm512_maskz_loadu_ps(m, polarization + nn);
+        const __m512 value = _mm512_maskz_loadu_ps(m, e + nn);
+        const __m512 next = _mm512_fmadd_ps(drive, value,
+            _mm512_fmadd_ps(alpha, p, _mm512_maskz_loadu_ps(m, carry + nn)));
+        const __m512 carried = _mm512_fmadd_ps(lag, _mm512_maskz_loadu_ps(m, previous + nn),
+            _mm512_fmadd_ps(lead, value, _mm512_mul_ps(xi, p)));
+        _mm512_mask_storeu_ps(polarization + nn, m, next);
+        _mm512_mask_storeu_ps(carry + nn, m, carried);
+    }
+}
+
+template <typename S>
+static inline __m512 curlDifference16(__mmask16 m, const CurlRow<S, float> &r, int nn) {
+    return _mm512_sub_ps(
+        _mm512_sub_ps(load16(m, r.a + nn), load16(m, r.aPrev + nn)),
+        _mm512_sub_ps(load16(m, r.b + nn), load16(m, r.bPrev + nn)));
+}
+
+template <typename S>
+static void curlRow(const CurlRow<S, float> &r, int begin, int end) {
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 c0, c1;
+        gather16(m, r.coefficients, r.material + nn, c0, c1);
+        __m512 value = _mm512_fmadd_ps(c1, curlDifference16(m, r, nn), _mm512_mul_ps(c0, load16(m, r.f + nn)));
+        store16(m, r.f + nn, value);
+    }
+}
+
+template <typename S>
+static void curlRowUniform(const CurlRow<S, float> &r, float c0, float c1, int begin, int end) {
+    const __m512 vc0 = _mm512_set1_ps(c0);
+    const __m512 vc1 = _mm512_set1_ps(c1);
+    for (int nn = begin; nn < end; nn += 16) {
+        __mmask16 m = tailMask(end - nn);
+        __m512 value = _mm512_fmadd_ps(vc1, curlDifference16(m, r, nn), _mm512_mul_ps(vc0, load16(m, r.f + nn)));
+        store16(m, r.f + nn, value);
+    }
+}
+
+template <typename S, typename C>
+const KernelTable<S, C> *avx512Kernels() {
+    if constexpr (std::is_same_v<C, float>) {
+        static const KernelTable<S, C> table = {"avx512",
+            electricRow<S>, magneticXRow<S>, magneticYRow<S>,
+            electricRowUniform<S>, magneticXRowUniform<S>, magneticYRowUniform<S>, dftRow<S>,
+            poleHistory, poleStep, curlRow<S>, curlRowUniform<S>};
+        return &table;
+    } else {
+        return nullptr;
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template const KernelTable<S, C> *avx512Kernels<S, C>();
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
+
+static void colorizeRow(const float *values, const ConductorMask::Word *conductor, std::uint32_t *out, int n,
+    const ColorizeParams &params) {
+    const __m512 scale = _mm512_set1_ps(params.scale);
+    const __m512 offset = _mm512_set1_ps(params.offset);
+    const __m512 top = _mm512_set1_ps(params.maxIndex);
+    const __m512i conductorColor = _mm512_set1_epi32(static_cast<int>(params.conductorColor));
+
+    for (int nn = 0; nn < n; nn += 16) {
+        __mmask16 m = tailMask(n - nn);
+        // max_ps returns its second operand for NaN
+        __m512 t = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, values + nn), scale, offset);
+        t = _mm512_min_ps(_mm512_max_ps(t, _mm512_setzero_ps()), top);
+        __m512i color = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, _mm512_cvttps_epi32(t), params.lut, 4);
+        if (conductor) {
+            __mmask16 flags = static_cast<__mmask16>(ConductorMask::bits(conductor, nn));
+            color = _mm512_mask_blend_epi32(flags, color, conductorColor);
+        }
+        _mm512_mask_storeu_epi32(out + nn, m, color);
+    }
+}
+
+const ColorizeTable *avx512Colorizer() {
+    static const ColorizeTable table = {"avx512", colorizeRow};
+    return &table;
+}
@@ -0,0 +1,251 @@
+#include <type_traits>
+#include <arm_neon.h>
+
+#include "Kernels.hpp"
+
+// 4 cells per instruction, unrolled twice for E_z. NEON is part of every
+// AArch64 CPU, so this set needs no run-time check. float, Half and
+// BFloat16 storage all compute in float.
+
+template <typename S>
+static inline float32x4_t load4(const S *p) {
+    if constexpr (std::is_same_v<S, float>) {
+        return vld1q_f32(p);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(p))));
+    } else {
+        return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(reinterpret_cast<const uint16_t*>(p)), 16));
+    }
+}
+
+template <typename S>
+static inline void store4(S *p, float32x4_t v) {
+    if constexpr (std::is_same_v<S, float>) {
+        vst1q_f32(p, v);
+    } else if constexpr (std::is_same_v<S, Half>) {
+        vst1_u16(reinterpret_cast<uint16_t*>(p), vreinterpret_u16_f16(vcvt_f16_f32(v)));
+    } else {
+        // round to nearest even on the dropped 16 bits
+        uint32x4_t w = vreinterpretq_u32_f32(v);
+        uint32x4_t odd = vandq_u32(vshrq_n_u32(w, 16), vdupq_n_u32(1));
+        uint32x4_t rounded = vaddq_u32(w, vaddq_u32(vdupq_n_u32(0x7FFF), odd));
+        vst1_u16(reinterpret_cast<uint16_t*>(p), vshrn_n_u32(rounded, 16));
+    }
+}
+
+// Coefficient pair (c[0], c[1]) of the material of 4 cells. NEON has no
+// gather, so the pairs are collected through the stack.
+static inline void gather4(const float *coefficients, const std::uint8_t *material, float32x4_t &first, float32x4_t &second) {
+    float a[4], b[4];
+    for (int lane = 0; lane < 4; lane++) {
+        const float *c = coefficients + kCoefficientStride * material[lane];
+        a[lane] = c[0];
+        b[lane] = c[1];
+    }
+    first = vld1q_f32(a);
+    second = vld1q_f32(b);
+}
+
+template <typename S>
+static inline float32x4_t curl4(const ElectricRow<S, float> &r, int nn) {
+    return vsubq_f32(
+        vsubq_f32(load4(r.hy + nn), load4(r.hyPrev + nn)),
+        vsubq_f32(load4(r.hx + nn), load4(r.hx + nn - 1)));
+}
+
+template <typename S>
+static inline float32x4_t electricQuad(const ElectricRow<S, float> &r, int nn) {
+    float32x4_t ce, ch;
+    gather4(r.coefficients, r.material + nn, ce, ch);
+    return vfmaq_f32(vmulq_f32(ce, load4(r.ez + nn)), ch, curl4(r, nn));
+}
+
+template <typename S>
+static void electricRow(const ElectricRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        float32x4_t lo = electricQuad(r, nn);
+        float32x4_t hi = electricQuad(r, nn + 4);
+
+        const uint32_t lanesLo[4] = {1, 2, 4, 8};
+        const uint32_t lanesHi[4] = {16, 32, 64, 128};
+        uint32x4_t cond = vdupq_n_u32(static_cast<uint32_t>(ConductorMask::bits(r.conductor, nn)));
+        uint32x4_t vacuumLo = vceqzq_u32(vandq_u32(cond, vld1q_u32(lanesLo)));
+        uint32x4_t vacuumHi = vceqzq_u32(vandq_u32(cond, vld1q_u32(lanesHi)));
+
+        store4(r.ez + nn, vreinterpretq_f32_u32(vandq_u32(vacuumLo, vreinterpretq_u32_f32(lo))));
+        store4(r.ez + nn + 4, vreinterpretq_f32_u32(vandq_u32(vacuumHi, vreinterpretq_u32_f32(hi))));
+    }
+    scalarKernels<S, float>()->electricRow(r, nn, end);
+}
+
+template <typename S>
+static void magneticXRow(const MagneticRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        float32x4_t hh, he;
+        gather4(r.coefficients, r.material + nn, hh, he);
+        float32x4_t diff = vsubq_f32(load4(r.ez + nn + 1), load4(r.ez + nn));
+        store4(r.h + nn, vfmsq_f32(vmulq_f32(hh, load4(r.h + nn)), he, diff));
+    }
+    scalarKernels<S, float>()->magneticXRow(r, nn, end);
+}
+
+template <typename S>
+static void magneticYRow(const MagneticRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        float32x4_t hh, he;
+        gather4(r.coefficients, r.material + nn, hh, he);
+        float32x4_t diff = vsubq_f32(load4(r.ezNext + nn), load4(r.ez + nn));
+        store4(r.h + nn, vfmaq_f32(vmulq_f32(hh, load4(r.h + nn)), he, diff));
+    }
+    scalarKernels<S, float>()->magneticYRow(r, nn, end);
+}
+
+template <typename S>
+static void electricRowUniform(const ElectricRow<S, float> &r, float ce, float ch, int begin, int end) {
+    const float32x4_t vce = vdupq_n_f32(ce);
+    const float32x4_t vch = vdupq_n_f32(ch);
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        store4(r.ez + nn, vfmaq_f32(vmulq_f32(vce, load4(r.ez + nn)), vch, curl4(r, nn)));
+    }
+    scalarKernels<S, float>()->electricRowUniform(r, ce, ch, nn, end);
+}
+
+template <typename S>
+static void magneticXRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const float32x4_t vhh = vdupq_n_f32(hh);
+    const float32x4_t vhe = vdupq_n_f32(he);
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        float32x4_t diff = vsubq_f32(load4(r.ez + nn + 1), load4(r.ez + nn));
+        store4(r.h + nn, vfmsq_f32(vmulq_f32(vhh, load4(r.h + nn)), vhe, diff));
+    }
+    scalarKernels<S, float>()->magneticXRowUniform(r, hh, he, nn, end);
+}
+
+template <typename S>
+static void magneticYRowUniform(const MagneticRow<S, float> &r, float hh, float he, int begin, int end) {
+    const float32x4_t vhh = vdupq_n_f32(hh);
+    const float32x4_t vhe = vdupq_n_f32(he);
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        float32x4_t diff = vsubq_f32(load4(r.ezNext + nn), load4(r.ez + nn));
+        store4(r.h + nn, vfmaq_f32(vmulq_f32(vhh, load4(r.h + nn)), vhe, diff));
+    }
+    scalarKernels<S, float>()->magneticYRowUniform(r, hh, he, nn, end);
+}
+
+template <typename S>
+static void dftRow(const S *field, float *re, float *im, float cosine, float sine, int n) {
+    int nn = 0;
+    for (; nn + 4 <= n; nn += 4) {
+        float32x4_t value = load4(field + nn);
+        vst1q_f32(re + nn, vfmaq_n_f32(vld1q_f32(re + nn), value, cosine));
+        vst1q_f32(im + nn, vfmaq_n_f32(vld1q_f32(im + nn), value, sine));
+    }
+    scalarKernels<S, float>()->dftRow(field + nn, re + nn, im + nn, cosine, sine, n - nn);
+}
+
+static void poleHistory(const float *polarization, const float *carry, float *history,
+    const PoleCoefficients<float> &pole, int n) {
+    const float growth = pole.alpha - 1.0f;
+    int nn = 0;
+    for (; nn + 4 <= n; nn += 4) {
+        const float32x4_t known = vfmaq_n_f32(vld1q_f32(carry + nn), vld1q_f32(polarization + nn), growth);
+        vst1q_f32(history + nn, vaddq_f32(vld1q_f32(history + nn), known));
+    }
+    scalarKernels<float, float>()->poleHistory(polarization + nn, carry + nn, history + nn, pole, n - nn);
+}
+
+static void poleStep(float *polarization, float *carry, const float *e, const float *previous,
+    const PoleCoefficients<float> &pole, int n) {
+    int nn = 0;
+    for (; nn + 4 <= n; nn += 4) {
+        const float32x4_t p = vld1q_f32(polarization + nn);
+        const float32x4_t value = vld1q_f32(e + nn);
+        const float32x4_t next = vfmaq_n_f32(vfmaq_n_f32(vld1q_f32(carry + nn), p, pole.alpha), value, pole.drive);
+        const float32x4_t carried = vfmaq_n_f32(vfmaq_n_f32(vmulq_n_f32(p, pole.xi), value, pole.lead),
+            vld1q_f32(previous + nn), pole.lag);
+        vst1q_f32(polarization + nn, next);
+        vst1q_f32(carry + nn, carried);
+    }
+    scalarKernels<float, float>()->poleStep(polarization + nn, carry + nn, e + nn, previous + nn, pole, n - nn);
+}
+
+template <typename S>
+static inline float32x4_t curlDifference4(const CurlRow<S, float> &r, int nn) {
+    return vsubq_f32(
+        vsubq_f32(load4(r.a + nn), load4(r.aPrev + nn)),
+        vsubq_f32(load4(r.b + nn), load4(r.bPrev + nn)));
+}
+
+template <typename S>
+static void curlRow(const CurlRow<S, float> &r, int begin, int end) {
+    int nn = begin;
+    for (; nn + 4 <= end; nn += 4) {
+        float32x4_t c0, c1;
+        gather4(r.coefficients, r.material + nn, c0, c1);
+        store4(r.f + nn, vfmaq_f32(vmulq_f32(c0, load4(r.f + nn)), c1, curlDifference4(r, nn)));
+    }
+    scalarKernels<S, float>()->curlRow(r, nn, end);
+}
+
+template <typename S>
+static void curlRowUniform(const CurlRow<S, float> &r, float c0, float c1, int begin, int end) {
+    const float32x4_t vc0 = vdupq_n_f32(c0);
+    const float32x4_t vc1 = vdupq_n_f32(c1);
+    int nn = begin;
+    for (; nn + 8 <= end; nn += 8) {
+        store4(r.f + nn, vfmaq_f32(vmulq_f32(vc0, load4(r.f + nn)), vc1, curlDifference4(r, nn)));
+        store4(r.f + nn + 4, vfmaq_f32(vmulq_f32(vc0, load4(r.f + nn + 4)), vc1, curlDifference4(r, nn + 4)));
+    }
+    scalarKernels<S, float>()->curlRowUniform(r, c0, c1, nn, end);
+}
+
+template <typename S, typename C>
+const KernelTable<S, C> *neonKernels() {
+    if constexpr (std::is_same_v<C, float>) {
+        static const KernelTable<S, C> table = {"neon",
+            electricRow<S>, magneticXRow<S>, magneticYRow<S>,
+            electricRowUniform<S>, magneticXRowUniform<S>, magneticYRowUniform<S>, dftRow<S>,
+            poleHistory, poleStep, curlRow<S>, curlRowUniform<S>};
+        return &table;
+    } else {
+        return nullptr;
+    }
+}
+
+#define EMSIM_INSTANTIATE(S, C) template const KernelTable<S, C> *neonKernels<S, C>();
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
+
+// The index arithmetic is vectorized; the table lookups go through the
+// stack as NEON has no gather.
+static void colorizeRow(const float *values, const ConductorMask::Word *conductor, std::uint32_t *out, int n,
+    const ColorizeParams &params) {
+    const float32x4_t scale = vdupq_n_f32(params.scale);
+    const float32x4_t offset = vdupq_n_f32(params.offset);
+    const float32x4_t top = vdupq_n_f32(params.maxIndex);
+
+    int nn = 0;
+    for (; nn + 4 <= n; nn += 4) {
+        // maxnm returns the number for NaN
+        float32x4_t t = vfmaq_f32(offset, vld1q_f32(values + nn), scale);
+        t = vminq_f32(vmaxnmq_f32(t, vdupq_n_f32(0.0f)), top);
+        std::int32_t index[4];
+        vst1q_s32(index, vcvtq_s32_f32(t));
+        for (int lane = 0; lane < 4; lane++) {
+            out[nn + lane] = conductor && ConductorMask::test(conductor, nn + lane) ? params.conductorColor : params.lut[index[lane]];
+        }
+    }
+    for (; nn < n; ++nn) {
+        out[nn] = colorizeValue(values[nn], conductor && ConductorMask::test(conductor, nn), params);
+    }
+}
+
+const ColorizeTable *neonColorizer() {
+    static const ColorizeTable table = {"neon", colorizeRow};
+    return &table;
+}
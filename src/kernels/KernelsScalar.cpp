@@ -0,0 +1,121 @@
+#include "Kernels.hpp"
+
+// Portable fallback, written so the compiler can still vectorize it for
+// the baseline instruction set. Fields are widened to Compute on load and
+// narrowed back to Storage on store.
+
+template <typename S, typename C>
+static void electricRow(const ElectricRow<S, C> &r, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        const C *c = r.coefficients + kCoefficientStride * r.material[nn];
+        C curl = (C(r.hy[nn]) - C(r.hyPrev[nn])) - (C(r.hx[nn]) - C(r.hx[nn-1]));
+        C value = c[0] * C(r.ez[nn]) + c[1] * curl;
+        r.ez[nn] = S(ConductorMask::test(r.conductor, nn) ? C(0) : value);
+    }
+}
+
+template <typename S, typename C>
+static void magneticXRow(const MagneticRow<S, C> &r, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        const C *c = r.coefficients + kCoefficientStride * r.material[nn];
+        r.h[nn] = S(c[0] * C(r.h[nn]) - c[1] * (C(r.ez[nn+1]) - C(r.ez[nn])));
+    }
+}
+
+template <typename S, typename C>
+static void magneticYRow(const MagneticRow<S, C> &r, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        const C *c = r.coefficients + kCoefficientStride * r.material[nn];
+        r.h[nn] = S(c[0] * C(r.h[nn]) + c[1] * (C(r.ezNext[nn]) - C(r.ez[nn])));
+    }
+}
+
+template <typename S, typename C>
+static void electricRowUniform(const ElectricRow<S, C> &r, C ce, C ch, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        C curl = (C(r.hy[nn]) - C(r.hyPrev[nn])) - (C(r.hx[nn]) - C(r.hx[nn-1]));
+        r.ez[nn] = S(ce * C(r.ez[nn]) + ch * curl);
+    }
+}
+
+template <typename S, typename C>
+static void magneticXRowUniform(const MagneticRow<S, C> &r, C hh, C he, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        r.h[nn] = S(hh * C(r.h[nn]) - he * (C(r.ez[nn+1]) - C(r.ez[nn])));
+    }
+}
+
+template <typename S, typename C>
+static void magneticYRowUniform(const MagneticRow<S, C> &r, C hh, C he, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        r.h[nn] = S(hh * C(r.h[nn]) + he * (C(r.ezNext[nn]) - C(r.ez[nn])));
+    }
+}
+
+template <typename S, typename C>
+static void dftRow(const S *field, C *re, C *im, C cosine, C sine, int n) {
+    for (int nn = 0; nn < n; ++nn) {
+        const C value = C(field[nn]);
+        re[nn] += cosine * value;
+        im[nn] += sine * value;
+    }
+}
+
+template <typename C>
+static void poleHistory(const C *polarization, const C *carry, C *history, const PoleCoefficients<C> &pole, int n) {
+    const C growth = pole.alpha - C(1);
+    for (int nn = 0; nn < n; ++nn) {
+        history[nn] += growth * polarization[nn] + carry[nn];
+    }
+}
+
+template <typename C>
+static void poleStep(C *polarization, C *carry, const C *e, const C *previous, const PoleCoefficients<C> &pole,
+    int n) {
+    for (int nn = 0; nn < n; ++nn) {
+        const C p = polarization[nn];
+        polarization[nn] = pole.alpha * p + carry[nn] + pole.drive * e[nn];
+        carry[nn] = pole.xi * p + pole.lead * e[nn] + pole.lag * previous[nn];
+    }
+}
+
+template <typename S, typename C>
+static void curlRow(const CurlRow<S, C> &r, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        const C *c = r.coefficients + kCoefficientStride * r.material[nn];
+        C curl = (C(r.a[nn]) - C(r.aPrev[nn])) - (C(r.b[nn]) - C(r.bPrev[nn]));
+        r.f[nn] = S(c[0] * C(r.f[nn]) + c[1] * curl);
+    }
+}
+
+template <typename S, typename C>
+static void curlRowUniform(const CurlRow<S, C> &r, C c0, C c1, int begin, int end) {
+    for (int nn = begin; nn < end; ++nn) {
+        C curl = (C(r.a[nn]) - C(r.aPrev[nn])) - (C(r.b[nn]) - C(r.bPrev[nn]));
+        r.f[nn] = S(c0 * C(r.f[nn]) + c1 * curl);
+    }
+}
+
+template <typename S, typename C>
+const KernelTable<S, C> *scalarKernels() {
+    static const KernelTable<S, C> table = {"scalar",
+        electricRow<S, C>, magneticXRow<S, C>, magneticYRow<S, C>,
+        electricRowUniform<S, C>, magneticXRowUniform<S, C>, magneticYRowUniform<S, C>, dftRow<S, C>,
+        poleHistory<C>, poleStep<C>, curlRow<S, C>, curlRowUniform<S, C>};
+    return &table;
+}
+
+#define EMSIM_INSTANTIATE(S, C) template const KernelTable<S, C> *scalarKernels<S, C>();
+EMSIM_FOR_EACH_PRECISION(EMSIM_INSTANTIATE)
+
+static void colorizeRow(const float *values, const ConductorMask::Word *conductor, std::uint32_t *out, int n,
+    const ColorizeParams &params) {
+    for (int nn = 0; nn < n; ++nn) {
+        out[nn] = colorizeValue(values[nn], conductor && ConductorMask::test(conductor, nn), params);
+    }
+}
+
+const ColorizeTable *scalarColorizer() {
+    static const ColorizeTable table = {"scalar", colorizeRow};
+    return &table;
+}
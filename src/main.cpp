@@ -1,12 +1,22 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window/WindowStyle.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <thread>
+#include <string>
 #include "Simulation.hpp"
+#include "CpuBackend.hpp"
+#include "FieldRenderer.hpp"
+#include "SimulationRunner.hpp"
 #include "Profiler.cpp"
 
+#ifdef EMSIM_HAS_METAL
+#include "MetalBackend.hpp"
+#endif
+
 #define DEBUG
 
 #ifdef DEBUG
@@ -20,8 +30,6 @@ const int windowHeight = 800;
 
 const int M = 301;
 const int N = 301;
-const int vertexArrayWidth = N + 1;
-const int vertexArrayHeight = M + 1;
 
 const double cellWidth = windowWidth / (double) N;
 const double cellHeight = windowHeight / (double) M;
@@ -30,77 +38,97 @@ const double deltaX = 0.1;
 const double deltaY = 0.1;
 const double deltaT = 0.05;
 
-// multithreading constants
-const int NUMTHREADS = 10;
-
-sf::Color gradientRedBlue(double value) {
-    double range = 0.3;
-    value = std::clamp(value, -range, range);
-    double fraction = sqrt(abs(value) / range);
-    int r(0), g(0), b(0);
-    if (value > 0) {
-        r = static_cast<int> (fraction * 255);
-    } else {
-        b = static_cast<int> (fraction * 255);
-    }
-    return sf::Color(r, g, b);
+// The demo closes once the simulated time reaches this.
+const double endTime = 5.0;
+
+// Half width of the mirror brush, in cells.
+const double brushRadius = 0.75;
+
+// Workers colouring the field; the solver has its own pool.
+const int renderThreads = 4;
+
+int convertPixelToIndexX(int x) {
+    return static_cast<int>(static_cast<double>(x) / cellWidth);
 }
 
-sf::Color gradientGrayScale(double value) {
-    double range = 0.3;
-    value = std::clamp(value, -range, range);
-    double fraction = value / (2 * range);
-    int r = static_cast<int>(fraction * 255) + 127;
-    int g = static_cast<int>(fraction * 255) + 127;
-    int b = static_cast<int>(fraction * 255) + 127;
-    return sf::Color(r, g, b);
+
+int convertPixelToIndexY(int y) {
+    return static_cast<int>(static_cast<double>(y) / cellHeight);
 }
 
-void copyToVertexArray(sf::VertexArray& vertexArray, Linear2DVector<char>& conductorField, int start, int end, DECIMAL *gpuEz) {
-    for (int i = start; i <= end; i++) { // assume start < end
-        sf::Color cellColor = gradientRedBlue(gpuEz[i]);
-        if (conductorField.get(i / N, i % N) == 1) {
-            cellColor = sf::Color::Magenta;
-        }
-        for(int offset = 0; offset < 6; offset++) {
-            vertexArray[6*i + offset].color = cellColor;
+
+// Picks the backend from "--backend cpu|metal", defaulting to the GPU
+// when it was compiled in. "--threads N" sets the CPU worker count and
+// "--pin" pins the CPU workers to one core each.
+bool selectBackend(Simulation& sim, int argc, char **argv) {
+#ifdef EMSIM_HAS_METAL
+    std::string backend = "metal";
+#else
+    std::string backend = "cpu";
+#endif
+    int threads = 0;
+    int firstCpu = -1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--pin") == 0) {
+            firstCpu = 0;
+        } else if (i + 1 == argc) {
+            break;
+        } else if (std::strcmp(argv[i], "--backend") == 0) {
+            backend = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::atoi(argv[i + 1]);
         }
     }
-}
 
-sf::VertexArray createVertexArray() {
-    sf::VertexArray vertices(sf::Triangles);
-
-    // iterate through each triangle adding the corresponding
-    // vertices and their positions
+    if (backend == "cpu") {
+        sim.useBackend<CpuBackend>(threads, firstCpu);
+        return true;
+    }
+#ifdef EMSIM_HAS_METAL
+    if (backend == "metal") {
+        sim.useBackend<MetalBackend>();
+        return true;
+    }
+#endif
+    std::cout << "Unknown or unavailable backend: " << backend << std::endl;
+    return false;
+}
 
-    for (int i = 0; i < M; ++i) {
-        for (int j = 0; j < N; ++j) {
-            vertices.append(sf::Vertex(sf::Vector2f(j * cellWidth, i * cellHeight), sf::Color::Black));
-            vertices.append(sf::Vertex(sf::Vector2f(j * cellWidth, (i + 1) * cellHeight), sf::Color::Black));
-            vertices.append(sf::Vertex(sf::Vector2f((j + 1) * cellWidth, i * cellHeight), sf::Color::Black));
 
-            vertices.append(sf::Vertex(sf::Vector2f((j + 1) * cellWidth, i * cellHeight), sf::Color::Black));
-            vertices.append(sf::Vertex(sf::Vector2f(j * cellWidth, (i + 1) * cellHeight), sf::Color::Black));
-            vertices.append(sf::Vertex(sf::Vector2f((j + 1) * cellWidth, (i + 1) * cellHeight), sf::Color::Black));
+// "--pml N" replaces the reflecting edges with an N cell absorbing layer.
+bool selectBoundary(Simulation& sim, int argc, char **argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--pml") == 0) {
+            CpmlParameters parameters;
+            parameters.thickness = std::atoi(argv[i + 1]);
+            if (!sim.setAbsorbingBoundary(parameters)) {
+                std::cout << "PML does not fit the grid" << std::endl;
+                return false;
+            }
         }
     }
-    return vertices;
+    return true;
 }
 
 
-int convertPixelToIndexX(int x) {
-    return static_cast<int>(static_cast<double>(x) / cellWidth);
+void cycleColormap(FieldColorizer& colorizer) {
+    const auto& maps = Colormap::all();
+    auto current = std::find(maps.begin(), maps.end(), &colorizer.colormap());
+    colorizer.setColormap(current + 1 == maps.end() ? *maps.front() : **(current + 1));
 }
 
 
-int convertPixelToIndexY(int y) {
-    return static_cast<int>(static_cast<double>(y) / cellHeight);
+void cycleRangeMode(FieldColorizer& colorizer) {
+    switch (colorizer.mode()) {
+        case RangeMode::Fixed: colorizer.setRangeMode(RangeMode::Symmetric); break;
+        case RangeMode::Symmetric: colorizer.setRangeMode(RangeMode::Auto); break;
+        case RangeMode::Auto: colorizer.setRangeMode(RangeMode::Fixed); break;
+    }
 }
 
 
-int main() {
-    DEBUG_CODE(Profiler stepProfiler;Profiler drawProfiler;);
+int main(int argc, char **argv) {
+    DEBUG_CODE(Profiler drawProfiler;);
     
     sf::Texture playTexture, pauseTexture;
     sf::Sprite runningSprite;
@@ -122,13 +150,22 @@ int main() {
 
     sf::RenderWindow window(sf::VideoMode(windowWidth, windowHeight), "EM Sim", sf::Style::Titlebar | sf::Style::Close);
     Simulation sim(M, N, deltaX, deltaY, deltaT);
+    if (!selectBackend(sim, argc, argv) || !selectBoundary(sim, argc, argv)) {
+        return 1;
+    }
 
-    sf::VertexArray vertices = createVertexArray();
+    FieldRenderer renderer(M, N, windowWidth, windowHeight);
+    ThreadPool renderPool(renderThreads);
+    window.setFramerateLimit(60);
 
-    double time = 0.0;
+    // From here on the solver thread owns sim; the UI talks to it through
+    // the runner.
+    SimulationRunner runner(sim);
+    runner.setEndTime(endTime);
+    runner.start();
 
     while (window.isOpen()) {
-        if (time >= 5) {
+        if (runner.frame().time >= endTime) {
             break;
         }
         sf::Event event;
@@ -138,11 +175,16 @@ int main() {
             if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::Space) {
                     paused = not paused;
+                    runner.setPaused(paused);
                     if (paused) {
                         runningSprite.setTexture(pauseTexture);
                     } else {
                         runningSprite.setTexture(playTexture);
                     }
+                } else if (event.key.code == sf::Keyboard::C) {
+                    cycleColormap(renderer.colorizer());
+                } else if (event.key.code == sf::Keyboard::R) {
+                    cycleRangeMode(renderer.colorizer());
                 }
             }
             if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
@@ -159,83 +201,35 @@ int main() {
             }
         }
 
-        if (!paused) {
-            DEBUG_CODE(stepProfiler.start(););
-            sim.gpuStepElectricField();
-            sim.stepRickertSource(time, 0.0);
-            sim.gpuStepMagneticField();
-            time += deltaT;
-            DEBUG_CODE(stepProfiler.stop(););
-        }
-
         sf::Vector2i mousePos = sf::Mouse::getPosition(window);
-        int low_x = convertPixelToIndexX(std::min(prevMousePos.x, mousePos.x));
-        int high_x = convertPixelToIndexX(std::max(prevMousePos.x, mousePos.x));
-        int low_y = convertPixelToIndexY(std::min(prevMousePos.y, mousePos.y));
-        int high_y = convertPixelToIndexY(std::max(prevMousePos.y, mousePos.y));
 
         DEBUG_CODE(drawProfiler.start(););
-        if (leftIsPressed) {
-
-            for (int i = low_x; i <= high_x; i++) {
-                for (int j = low_y; j <= high_y; j++) {
-                    sim.addConductorAt(j, i);
-                }
-            }
-        }
-
-        if (rightIsPressed) {
-            for (int i = low_x; i <= high_x; i++) {
-                for (int j = low_y; j <= high_y; j++) {
-                    sim.removeConductorAt(j, i);
-                }
-            }
+        if (leftIsPressed || rightIsPressed) {
+            // Brush along the path since the last frame, wide enough that
+            // a diagonal drag leaves no gap between cells.
+            auto kind = leftIsPressed ? SimulationEdit::AddConductor : SimulationEdit::RemoveConductor;
+            runner.post({kind, convertPixelToIndexY(prevMousePos.y), convertPixelToIndexX(prevMousePos.x),
+                convertPixelToIndexY(mousePos.y), convertPixelToIndexX(mousePos.x), SimulationEdit::Stroke, brushRadius});
         }
 
-        DECIMAL *gpuE_z = static_cast<DECIMAL*> (sim.bufferE_z->contents());
-        std::vector<std::thread> threads;
-
-        for (int i = 0; i < NUMTHREADS; i++) {
-            int indicesPerThread = ceil((M * N) / ((double) NUMTHREADS));
-            threads.emplace_back(
-                 copyToVertexArray,
-                 std::ref(vertices),
-                 std::ref(sim.conductorField),
-                 indicesPerThread * i, 
-                 std::min(indicesPerThread * (i+1)-1, M * N - 1),
-                 gpuE_z
-             );
+        // Only recolor when the solver published something new.
+        if (runner.refresh()) {
+            const FieldFrame &frame = runner.frame();
+            renderer.update(frame.ez.origin(), frame.ez.pitch(), frame.conductor, renderPool);
         }
 
-        for(auto& thread: threads) {
-            thread.join();
-        }
-
-
-        // for (int mm = 0; mm < M; ++mm) {
-        //     for (int nn = 0; nn < N; ++nn) {
-        //         int idx = 6 * (mm * N + nn);
-        //         sf::Color cellColor = gradientRedBlue(gpuE_z[mm * N + nn]);
-        //         if (sim.conductorField.get(mm, nn) == 1) {
-        //             cellColor = sf::Color::Magenta;
-        //         }
-        //
-        //         for (int offset = 0; offset < 6; ++offset) {
-        //             vertices[idx + offset].color = cellColor;
-        //         }
-        //     }
-        // }
-
         DEBUG_CODE(drawProfiler.stop(););
         prevMousePos = mousePos;
         window.clear();
-        window.draw(vertices);
+        renderer.draw(window);
         window.draw(runningSprite);
         window.display();
     }
 
+    runner.stop();
+
     DEBUG_CODE(
-        std::cout << "Stepping took: " << stepProfiler.getAverageDuration() << std::endl;
+        std::cout << "Stepping: " << runner.steps() << " steps, " << runner.stepsPerSecond() << " steps/s" << std::endl;
         std::cout << "Drawing took: " << drawProfiler.getAverageDuration() << std::endl;
     );
 
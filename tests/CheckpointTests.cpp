@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "Checkpoint.hpp"
+
+// A run restored from a checkpoint has to continue exactly like the run
+// it was taken from. Both the direct and the background writer are
+// checked, and a checkpoint must not load into a different grid.
+
+static int failures = 0;
+
+static void fail(const char *what, const std::string &detail = "") {
+    std::printf("%s %s\n", what, detail.c_str());
+    failures++;
+}
+
+static void setUp(Simulation &sim) {
+    MaterialCoefficients<float> dielectric = sim.vacuumCoefficients();
+    dielectric.ezh *= 0.4f;
+    const int id = sim.addMaterial(dielectric);
+    for (int i = 90; i < 120; i++) {
+        for (int j = 30; j < 100; j++) {
+            sim.setMaterialAt(i, j, id);
+        }
+    }
+    sim.fillConductors({40, 110, 50, 150});
+    CpmlParameters pml;
+    pml.thickness = 8;
+    sim.setAbsorbingBoundary(pml);
+}
+
+template <typename T>
+static bool same(const Linear2DVector<T> &a, const Linear2DVector<T> &b) {
+    return std::memcmp(a.storage(), b.storage(), a.storageSize() * sizeof(T)) == 0;
+}
+
+static void compareRestart(bool background, const std::string &path) {
+    const int size = 160;
+    Simulation original(size, size, 0.1f, 0.1f, 0.05f);
+    setUp(original);
+    original.advance(60);
+
+    std::string error;
+    if (background) {
+        CheckpointWriter writer;
+        writer.save(original, path, 60);
+        // The writer works from its own copy, so the solver may go on.
+        original.advance(1);
+        if (!writer.wait(error)) {
+            return fail("background save:", error);
+        }
+        original.advance(79);
+    } else {
+        if (!saveCheckpoint(original, path, 60, error)) {
+            return fail("save:", error);
+        }
+        original.advance(80);
+    }
+
+    // A plain grid of the same size: materials, conductors and the CPML
+    // all come from the file.
+    Simulation restored(size, size, 0.1f, 0.1f, 0.05f);
+    long step = 0;
+    if (!loadCheckpoint(restored, path, step, error)) {
+        return fail("load:", error);
+    }
+    if (step != 60 || restored.absorbingBoundary() == nullptr) {
+        return fail("restored step or CPML wrong");
+    }
+    restored.advance(80);
+
+    original.synchronize();
+    restored.synchronize();
+    if (original.time != restored.time || !same(original.E_z, restored.E_z) ||
+        !same(original.H_x, restored.H_x) || !same(original.H_y, restored.H_y)) {
+        fail(background ? "background checkpoint:" : "checkpoint:", "restored run diverges");
+    }
+
+    Simulation other(size, size + 1, 0.1f, 0.1f, 0.05f);
+    if (loadCheckpoint(other, path, step, error)) {
+        fail("checkpoint loaded into a different grid");
+    }
+}
+
+int main() {
+    const std::string path = (std::filesystem::temp_directory_path() /
+        ("emsim_checkpoint_test_" + std::to_string(getpid()) + ".emck")).string();
+    compareRestart(false, path);
+    compareRestart(true, path);
+    std::filesystem::remove(path);
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Kernels.hpp"
+
+// Runs every SIMD kernel set the CPU supports against the scalar one on
+// random rows, for every precision. The widths leave every possible
+// partial vector at the end of the row, so the scalar tail is checked
+// along with the vector body. FMA rounds once where the scalar code
+// rounds twice, so results may differ in the last place of Storage.
+
+static int failures = 0;
+
+template <typename S> double tolerance();
+template <> double tolerance<float>() { return 1e-5; }
+template <> double tolerance<double>() { return 1e-12; }
+template <> double tolerance<Half>() { return 2e-3; }
+template <> double tolerance<BFloat16>() { return 1.6e-2; }
+
+template <typename S>
+static void compare(const char *isa, const char *kernel, int width, const std::vector<S> &expected,
+    const std::vector<S> &actual) {
+    for (size_t k = 0; k < expected.size(); k++) {
+        double e = double(expected[k]), a = double(actual[k]);
+        if (std::fabs(e - a) > tolerance<S>() * (1.0 + std::fabs(e))) {
+            std::printf("%s %s (%zu-byte storage), width %d: column %zu is %g, scalar gives %g\n", isa,
+                kernel, sizeof(S), width, k, a, e);
+            failures++;
+            return;
+        }
+    }
+}
+
+template <typename S, typename C>
+static void checkKernels(const KernelTable<S, C> &scalar, const KernelTable<S, C> &simd) {
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    const int kMaterials = 4;
+    std::vector<C> coefficients(kCoefficientStride * kMaterials);
+    for (C &c: coefficients) {
+        c = C(value(random));
+    }
+
+    for (int width = 1; width <= 70; width++) {
+        // Column 0 is only read, as the nn-1 neighbour of the first cell.
+        int begin = 1, end = begin + width, n = end + 1;
+        auto fill = [&] {
+            std::vector<S> v(n);
+            for (S &x: v) {
+                x = S(value(random));
+            }
+            return v;
+        };
+
+        std::vector<S> ez = fill(), hy = fill(), hyPrev = fill(), hx = fill();
+        std::vector<std::uint8_t> material(n);
+        ConductorMask conductor(1, n);
+        for (int k = 0; k < n; k++) {
+            material[k] = random() % kMaterials;
+            conductor.set(0, k, random() % 5 == 0);
+        }
+
+        std::vector<S> expected = ez, actual = ez;
+        ElectricRow<S, C> e = {expected.data(), hy.data(), hyPrev.data(), hx.data(), material.data(),
+            conductor.row(0), coefficients.data()};
+        scalar.electricRow(e, begin, end);
+        e.ez = actual.data();
+        simd.electricRow(e, begin, end);
+        compare(simd.isa, "electricRow", width, expected, actual);
+
+        expected = ez;
+        actual = ez;
+        e.ez = expected.data();
+        scalar.electricRowUniform(e, coefficients[0], coefficients[1], begin, end);
+        e.ez = actual.data();
+        simd.electricRowUniform(e, coefficients[0], coefficients[1], begin, end);
+        compare(simd.isa, "electricRowUniform", width, expected, actual);
+
+        std::vector<S> h = fill(), ezRow = fill(), ezNext = fill();
+        for (int y = 0; y < 2; y++) {
+            auto kernel = y ? &KernelTable<S, C>::magneticYRow : &KernelTable<S, C>::magneticXRow;
+            auto uniform = y ? &KernelTable<S, C>::magneticYRowUniform : &KernelTable<S, C>::magneticXRowUniform;
+            const C *c = coefficients.data() + 2 + 2 * y;
+
+            // H_x reads one column past end.
+            expected = h;
+            actual = h;
+            MagneticRow<S, C> m = {expected.data(), ezRow.data(), ezNext.data(), material.data(), c};
+            (scalar.*kernel)(m, begin, end - 1);
+            m.h = actual.data();
+            (simd.*kernel)(m, begin, end - 1);
+            compare(simd.isa, y ? "magneticYRow" : "magneticXRow", width, expected, actual);
+
+            expected = h;
+            actual = h;
+            m.h = expected.data();
+            (scalar.*uniform)(m, c[0], c[1], begin, end - 1);
+            m.h = actual.data();
+            (simd.*uniform)(m, c[0], c[1], begin, end - 1);
+            compare(simd.isa, y ? "magneticYRowUniform" : "magneticXRowUniform", width, expected, actual);
+        }
+
+        std::vector<C> re(width), im(width);
+        for (int k = 0; k < width; k++) {
+            re[k] = C(value(random));
+            im[k] = C(value(random));
+        }
+        std::vector<C> expectedRe = re, expectedIm = im;
+        scalar.dftRow(h.data(), expectedRe.data(), expectedIm.data(), coefficients[0], coefficients[1], width);
+        simd.dftRow(h.data(), re.data(), im.data(), coefficients[0], coefficients[1], width);
+        compare(simd.isa, "dftRow (re)", width, expectedRe, re);
+        compare(simd.isa, "dftRow (im)", width, expectedIm, im);
+
+        const PoleCoefficients<C> pole = {C(0.9), C(-0.3), C(0.02), C(0.01), C(-0.005)};
+        std::vector<C> polarization = re, carry = im, field(width), previous(width), history(width);
+        for (int k = 0; k < width; k++) {
+            field[k] = C(value(random));
+            previous[k] = C(value(random));
+            history[k] = C(value(random));
+        }
+        std::vector<C> expectedHistory = history;
+        scalar.poleHistory(polarization.data(), carry.data(), expectedHistory.data(), pole, width);
+        simd.poleHistory(polarization.data(), carry.data(), history.data(), pole, width);
+        compare(simd.isa, "poleHistory", width, expectedHistory, history);
+
+        std::vector<C> expectedPolarization = polarization, expectedCarry = carry;
+        scalar.poleStep(expectedPolarization.data(), expectedCarry.data(), field.data(), previous.data(), pole, width);
+        simd.poleStep(polarization.data(), carry.data(), field.data(), previous.data(), pole, width);
+        compare(simd.isa, "poleStep (polarization)", width, expectedPolarization, polarization);
+        compare(simd.isa, "poleStep (carry)", width, expectedCarry, carry);
+
+        std::vector<S> b = fill(), bPrev = fill();
+        expected = ez;
+        actual = ez;
+        CurlRow<S, C> curl = {expected.data(), hy.data(), hyPrev.data(), b.data(), bPrev.data(), material.data(),
+            coefficients.data()};
+        scalar.curlRow(curl, begin, end);
+        curl.f = actual.data();
+        simd.curlRow(curl, begin, end);
+        compare(simd.isa, "curlRow", width, expected, actual);
+
+        expected = ez;
+        actual = ez;
+        curl.f = expected.data();
+        scalar.curlRowUniform(curl, coefficients[2], coefficients[3], begin, end);
+        curl.f = actual.data();
+        simd.curlRowUniform(curl, coefficients[2], coefficients[3], begin, end);
+        compare(simd.isa, "curlRowUniform", width, expected, actual);
+    }
+}
+
+static int checked = 0;
+
+template <typename S, typename C>
+static void checkPrecision() {
+    const KernelTable<S, C> *scalar = scalarKernels<S, C>();
+    for (const char *isa: {"avx2", "avx512", "neon"}) {
+        if (const KernelTable<S, C> *table = findKernels<S, C>(isa)) {
+            checkKernels(*scalar, *table);
+            checked++;
+        }
+    }
+}
+
+// Colour conversion has to match exactly, including values that clamp,
+// NaNs and conductor cells.
+static void checkColorizer(const ColorizeTable &simd) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> value(-1.5f, 1.5f);
+    std::vector<std::uint32_t> lut(256);
+    for (std::uint32_t &colour: lut) {
+        colour = random();
+    }
+    const ColorizeParams params = {lut.data(), 127.5f, 127.5f, 255.0f, 0xFF0000FFu};
+
+    for (int n = 1; n <= 70; n++) {
+        std::vector<float> values(n);
+        ConductorMask conductor(1, n);
+        for (int k = 0; k < n; k++) {
+            values[k] = k % 13 == 5 ? std::nanf("") : value(random);
+            conductor.set(0, k, random() % 5 == 0);
+        }
+        const ConductorMask::Word *masks[] = {nullptr, conductor.row(0)};
+        for (const ConductorMask::Word *mask: masks) {
+            std::vector<std::uint32_t> expected(n), actual(n);
+            scalarColorizer()->colorizeRow(values.data(), mask, expected.data(), n, params);
+            simd.colorizeRow(values.data(), mask, actual.data(), n, params);
+            if (expected != actual) {
+                std::printf("%s colorizeRow, width %d%s: colours differ\n", simd.isa, n,
+                    mask ? " with conductors" : "");
+                failures++;
+            }
+        }
+    }
+}
+
+int main() {
+#define EMSIM_CHECK_PRECISION(S, C) checkPrecision<S, C>();
+    EMSIM_FOR_EACH_PRECISION(EMSIM_CHECK_PRECISION)
+#undef EMSIM_CHECK_PRECISION
+    for (const char *isa: {"avx2", "avx512", "neon"}) {
+        if (const ColorizeTable *table = findColorizer(isa)) {
+            checkColorizer(*table);
+            checked++;
+        }
+    }
+    std::printf("%d SIMD tables checked, %d mismatches\n", checked, failures);
+    return failures == 0 ? 0 : 1;
+}
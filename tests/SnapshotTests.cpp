@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Simulation.hpp"
+#include "SnapshotFile.hpp"
+
+// Round trip through SnapshotWriter and SnapshotReader. The grid is not a
+// multiple of the chunk size and mixes quiet regions, which pack into
+// runs, with noise, which does not pack and is stored raw; every value
+// has to come back exactly, through windows that cut across chunks.
+// Reopening for append has to drop the frames a restart repeats.
+
+static int failures = 0;
+
+static void fail(const char *what, const std::string &detail = "") {
+    std::printf("%s %s\n", what, detail.c_str());
+    failures++;
+}
+
+static bool matches(SnapshotReader &reader, int frame, FieldComponent field, const Linear2DVector<float> &expected,
+    const MaskRect &window) {
+    const int width = window.j1 - window.j0;
+    std::vector<float> values((window.i1 - window.i0) * width);
+    std::string error;
+    if (!reader.readWindow(frame, field, window, values.data(), width, error)) {
+        fail("readWindow:", error);
+        return false;
+    }
+    for (int i = window.i0; i < window.i1; i++) {
+        for (int j = window.j0; j < window.j1; j++) {
+            if (values[(i - window.i0) * width + (j - window.j0)] != expected.get(i, j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    const std::string path = (std::filesystem::temp_directory_path() /
+        ("emsim_snapshot_test_" + std::to_string(getpid()) + ".emsnap")).string();
+    const int m = 150, n = 201;
+    const unsigned fields = snapshotFieldBit(FieldComponent::Ez) | snapshotFieldBit(FieldComponent::Hy);
+
+    Simulation sim(m, n, 0.1f, 0.1f, 0.05f);
+    sim.advance(40);
+    sim.synchronize();
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    for (int i = 0; i < 64; i++) {
+        for (int j = 130; j < n; j++) {
+            sim.E_z.get(i, j) = noise(random);
+        }
+    }
+
+    std::string error;
+    std::vector<Linear2DVector<float>> ez, hy;
+    SnapshotWriter writer;
+    if (!writer.open(path, m, n, fields, error)) {
+        fail("open:", error);
+        return 1;
+    }
+    for (long step: {10, 20, 30}) {
+        writer.capture(sim, step);
+        ez.push_back(sim.E_z);
+        hy.push_back(sim.H_y);
+        sim.advance(15);
+        sim.synchronize();
+    }
+    if (!writer.close(error)) {
+        fail("close:", error);
+    }
+
+    SnapshotReader reader;
+    if (!reader.open(path, error)) {
+        fail("reopen:", error);
+        return 1;
+    }
+    if (reader.frameCount() != 3 || reader.rows() != m || reader.columns() != n ||
+        reader.hasField(FieldComponent::Hx)) {
+        fail("wrong frame count or header");
+    }
+    const MaskRect windows[] = {{0, 0, m, n}, {50, 60, 70, 140}, {63, 127, 65, 201}, {149, 200, 150, 201}};
+    for (int frame = 0; frame < reader.frameCount() && frame < 3; frame++) {
+        for (const MaskRect &window: windows) {
+            if (!matches(reader, frame, FieldComponent::Ez, ez[frame], window) ||
+                !matches(reader, frame, FieldComponent::Hy, hy[frame], window)) {
+                fail("values differ in frame", std::to_string(frame));
+            }
+        }
+    }
+
+    // A run restarted from step 20 rewrites everything after it.
+    SnapshotWriter restarted;
+    if (!restarted.open(path, m, n, fields, error, true, 20)) {
+        fail("append:", error);
+    }
+    restarted.capture(sim, 25);
+    restarted.close(error);
+
+    SnapshotReader appended;
+    if (!appended.open(path, error) || appended.frameCount() != 3 || appended.frameStep(1) != 20 ||
+        appended.frameStep(2) != 25 || !matches(appended, 2, FieldComponent::Ez, sim.E_z, windows[0])) {
+        fail("append did not replace the frames after step 20");
+    }
+
+    std::filesystem::remove(path);
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
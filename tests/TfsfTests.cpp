@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "Simulation.hpp"
+#include "Tfsf.hpp"
+
+// With nothing inside the total-field rectangle the plane wave must stay
+// inside it: the peak of E_z outside, relative to the peak inside, is the
+// leakage. It is at round-off in double precision and about -117 dB in
+// float. A conductor in the rectangle has to scatter through it.
+
+static int failures = 0;
+
+template <typename S>
+static double leakage(TfsfDirection direction, bool scatterer) {
+    using C = typename DefaultCompute<S>::type;
+    BasicSimulation<S, C> sim(160, 180, C(0.1), C(0.1), C(0.05));
+    sim.sourceRow = -1;
+    CpmlParameters pml;
+    pml.thickness = 10;
+    sim.setAbsorbingBoundary(pml);
+    const MaskRect region{40, 50, 120, 130};
+    sim.setPlaneWave({region, direction});
+    if (scatterer) {
+        sim.fillConductors({75, 85, 85, 95});
+    }
+
+    double inside = 0.0, outside = 0.0;
+    for (int chunk = 0; chunk < 20; chunk++) {
+        sim.advance(20);
+        sim.synchronize();
+        for (int i = 0; i < sim.M; i++) {
+            for (int j = 0; j < sim.N; j++) {
+                const double value = std::fabs(double(sim.E_z.get(i, j)));
+                const bool total = i >= region.i0 && i < region.i1 && j >= region.j0 && j < region.j1;
+                (total ? inside : outside) = std::max(total ? inside : outside, value);
+            }
+        }
+    }
+    return inside > 0.0 ? outside / inside : 1.0;
+}
+
+template <typename S>
+static void check(const char *precision, double limit) {
+    const TfsfDirection directions[] = {TfsfDirection::PlusI, TfsfDirection::MinusI, TfsfDirection::PlusJ,
+        TfsfDirection::MinusJ};
+    for (TfsfDirection direction: directions) {
+        const double clean = leakage<S>(direction, false);
+        if (clean > limit) {
+            std::printf("%s, direction %d: leakage %g above %g\n", precision, static_cast<int>(direction), clean,
+                limit);
+            failures++;
+        }
+        const double scattered = leakage<S>(direction, true);
+        if (scattered < 1e-2) {
+            std::printf("%s, direction %d: a conductor only scatters %g\n", precision, static_cast<int>(direction),
+                scattered);
+            failures++;
+        }
+    }
+}
+
+int main() {
+    check<double>("f64", 1e-10);
+    check<float>("f32", 1e-5);
+    std::printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}